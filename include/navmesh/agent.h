@@ -1,5 +1,7 @@
 #pragma once
 #include "mesh.h"
+#include "path.h"
+#include "cooperative.h"
 
 
 namespace nav {
@@ -11,37 +13,83 @@ public:
 private:
     const nav::Mesh* p_mesh = nullptr;
     Vector2f m_position;
+    // triangle under m_position, followed across portals as the agent moves
+    size_t m_triangle = SIZE_MAX;
     float m_speed = 1.0f;
-
-    nav::Path m_path;
+    float m_radius = 0.f;
+
+    // waypoints funnelled so far, the rest is produced by m_lazy as the agent advances.
+    // m_path_dist[i] is the walked length up to m_path[i], m_path_dir[i] the unit direction on to m_path[i+1]
+    mutable nav::Path m_path;
+    mutable SmallVec<float, 8> m_path_dist;
+    mutable SmallVec<Vector2f, 8> m_path_dir;
+    mutable nav::LazyPath m_lazy;
     size_t m_path_index = 0;
     float m_path_prog = 0.f;
 
     bool m_override_stop = false;
 
+    // cooperative mode: the seat in the table the plan is reserved in, and the triangles it has to wait to enter
+    TableSeat m_seat;
+    std::vector<std::pair<size_t, u32>> m_holds;
+    u32 m_plan_slot = 0;
+    u32 m_wait_slot = 0;
+
 private:
     Agent(const nav::Mesh* mesh);
 
+    void pull_path(size_t count) const;
+    void pull_path_to(float dist) const;
+    void path_push(Vector2f pos) const;
+    void path_resize(size_t count) const;
+    void path_clear() const;
+    void move_to(Vector2f pos);
+    bool patch_start(std::vector<CrossInfo>& corridor) const;
+    void refunnel(const std::vector<CrossInfo>& corridor, Vector2f goal);
+    bool plan_cooperative(Vector2f goal);
+    bool is_held(size_t tri) const;
+    void leave_table();
+
 public:
     void set_speed(float speed);
     float get_speed() const;
+    void set_radius(float radius);
+    float get_radius() const;
 
     bool set_position(Vector2f pos);
     const Vector2f get_position() const;
+    std::optional<size_t> get_current_triangle() const;
 
     bool set_target_position(Vector2f goal);
+    // plans around the other agents' reservations in table and replans every half window while moving.
+    // the caller advances the table's clock once per frame
+    bool set_target_position(Vector2f goal, ReservationTable& table);
     Vector2f get_target_position() const;
 
+    // keep the current corridor and patch it locally, a full search only runs when patching fails.
+    // false if the agent cannot get to pos, or the search after a failed patch finds no way to the goal
+    bool move_position(Vector2f pos);
+    bool move_target_position(Vector2f goal);
+    void optimize_path();
+
     void trim_path_radial(float dist);
     void trim_path_walked(float dist);
 
     void clamp_path_radial(float max);
     void clamp_path_walked(float max);
 
+    // the whole path. the first call after a new path funnels all of it, which the agent otherwise does a few
+    // corners at a time as it walks. get_position_at only funnels up to dist
     const nav::Path& get_active_path() const;
     float get_active_path_length() const;
+    float get_remaining_length() const;
+    Vector2f get_position_at(float dist) const;
+    // the path as far as it is funnelled yet, reading it never funnels more
+    const nav::Path& get_funnelled_path() const;
+    float get_funnelled_length() const;
 
     size_t get_current_index() const;
+    // waypoints left on the whole path, funnelling all of it like get_active_path
     size_t get_inverse_index() const;
 
     bool is_moving() const;
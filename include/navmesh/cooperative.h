@@ -0,0 +1,87 @@
+#pragma once
+#include "mesh.h"
+#include <unordered_map>
+
+
+namespace nav {
+
+// shared space-time reservations over mesh triangles, for cooperative (windowed) pathfinding.
+// time is cut into slots of slot_time seconds, and a triangle holds as many agents per slot as it has lanes
+// of their width. plans only reserve the next window slots, past that they are plain corridor searches.
+// owners are ids handed out by join(), reservations older than the current slot expire
+class ReservationTable {
+private:
+    struct Node {
+        usize tri;
+        u32 t;
+        f32 g;
+        u32 parent;
+        u32 edge;
+        Vector2f entry;
+    };
+
+    const Mesh* p_mesh = nullptr;
+    f32 m_slot_time = 0.5f;
+    u32 m_window = 16;
+    f64 m_time = 0.0;
+    u32 m_slot = 0;
+
+    std::unordered_map<u64, SmallVec<usize, 4>> m_slots;
+    std::unordered_map<usize, std::vector<u64>> m_owned;
+    usize m_next_owner = 0;
+    // incircle radius per triangle, fixed with the mesh
+    std::vector<f32> m_inradius;
+
+    // search state, kept between plans
+    std::vector<Node> m_nodes;
+    std::vector<std::pair<f32, u32>> m_open;
+    std::unordered_map<u64, f32> m_best;
+
+    static u64 key(usize tri, u32 slot) { return ((u64)tri << 32) | slot; }
+    bool is_free(usize tri, u32 slot, usize owner, f32 radius) const;
+    void reserve(usize tri, u32 slot, usize owner);
+
+public:
+    ReservationTable(const Mesh* mesh, f32 slot_time = 0.5f, u32 window = 16);
+
+    // moves the clock on, dropping every slot that is now in the past
+    void advance(f32 deltatime);
+    u32 get_slot() const;
+    f32 get_slot_time() const;
+    u32 get_window() const;
+
+    // agents of radius that fit through tri side by side in one slot, and how many hold it in slot
+    u32 capacity(usize tri, f32 radius) const;
+    usize get_reserved(usize tri, u32 slot) const;
+
+    // a new owner id, never handed out twice by this table
+    usize join();
+    void release(usize owner);
+
+    // space-time A* from begin to end at speed units per second, waiting in place where the way ahead is taken.
+    // replaces the owner's reservations with the new plan. hold[i] is the slot before which corridor[i] may not
+    // be entered, 0 past the window
+    bool plan(usize owner, usize begin_tri, Vector2f begin, Vector2f end, f32 speed, f32 radius,
+              std::vector<CrossInfo>& corridor, std::vector<u32>& hold);
+};
+
+// an owner's place in a table, its reservations are released when it leaves or is destroyed. moving hands the
+// place over, it cannot be copied since two owners never share reservations. the table has to outlive it
+class TableSeat {
+private:
+    ReservationTable* p_table = nullptr;
+    usize m_owner = 0;
+
+public:
+    TableSeat() = default;
+    explicit TableSeat(ReservationTable& table);
+    TableSeat(TableSeat&& other) noexcept;
+    TableSeat& operator=(TableSeat&& other) noexcept;
+    ~TableSeat();
+
+    void leave();
+    ReservationTable* get_table() const;
+    usize get_owner() const;
+};
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "mesh.h"
+#include "path.h"
+#include "spatial.h"
+
+
+namespace nav {
+
+// allocates on cache line boundaries, so chunks of the hot arrays never share a line between threads
+template<typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+    constexpr static usize ALIGN = 64;
+
+    CacheAlignedAllocator() = default;
+    template<typename U> constexpr CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(usize n) { return (T*)::operator new(n * sizeof(T), std::align_val_t(ALIGN)); }
+    void deallocate(T* p, usize) { ::operator delete(p, std::align_val_t(ALIGN)); }
+
+    template<typename U> constexpr bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template<typename U> constexpr bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVec = std::vector<T, CacheAlignedAllocator<T>>;
+
+
+// many agents on one mesh, stored as parallel arrays so update() is a single sweep over contiguous data.
+// agents are addressed by the slot index returned from add(), slots of removed agents are reused
+class Crowd {
+public:
+    enum Flags : u8 {
+        ACTIVE = 1 << 0,
+        MOVING = 1 << 1,
+        PAUSED = 1 << 2,
+        REPLAN = 1 << 3,
+        FINAL  = 1 << 4,
+    };
+
+    // reciprocal velocity obstacle settings, times are in seconds. a neighbor_dist of 0 disables avoidance
+    struct Avoidance {
+        f32 neighbor_dist = 0.f;
+        u32 max_neighbors = 10;
+        f32 time_horizon = 1.f;
+        f32 time_horizon_obst = 0.5f;
+    };
+
+    // simulation level of detail around a focus point such as the camera. agents further than far_dist
+    // only move every far_interval updates, without avoidance, covering the skipped time in one step
+    struct Lod {
+        Vector2f focus;
+        f32 far_dist = std::numeric_limits<f32>::infinity();
+        u32 far_interval = 4;
+    };
+
+    // work allowed for queued replans per update, a limit of 0 disables it. at least one search runs per update
+    struct ReplanBudget {
+        usize max_expansions = 0;
+        f32 max_millis = 0.f;
+    };
+
+private:
+    const nav::Mesh* p_mesh = nullptr;
+
+    // hot, touched by every update sweep
+    AlignedVec<f32> m_pos_x;
+    AlignedVec<f32> m_pos_y;
+    AlignedVec<f32> m_next_x;
+    AlignedVec<f32> m_next_y;
+    AlignedVec<f32> m_vel_x;
+    AlignedVec<f32> m_vel_y;
+    AlignedVec<f32> m_avoid_x;
+    AlignedVec<f32> m_avoid_y;
+    AlignedVec<f32> m_speed;
+    AlignedVec<f32> m_carry;
+    AlignedVec<f32> m_lod_dt;
+    AlignedVec<u8> m_flags;
+    // moving agents per cache line of agents, lines without any are skipped by the sweeps
+    std::vector<u32> m_awake;
+
+    // cold, only touched when a waypoint is reached or a path is set
+    std::vector<f32> m_radius;
+    std::vector<u32> m_path_index;
+    std::vector<nav::LazyPath> m_paths;
+    std::vector<Vector2f> m_goal;
+    std::vector<f32> m_priority;
+    // triangle each agent was last located in and where it stood then, traced forward when a replan needs it
+    std::vector<usize> m_triangle;
+    std::vector<Vector2f> m_located;
+    std::vector<usize> m_free;
+    std::vector<usize> m_replans;
+    ReplanBudget m_budget;
+
+    Avoidance m_avoid;
+    Lod m_lod;
+    u32 m_tick = 0;
+    SpatialHash m_agent_hash;
+    SpatialHash m_wall_hash;
+    std::vector<Vector2f> m_wall_a;
+    std::vector<Vector2f> m_wall_b;
+
+    void set_flags(usize id, u8 flags);
+    bool is_far(usize id) const;
+    void advance(usize id);
+    void avoid_range(usize begin, usize end, f32 deltatime);
+    void update_range(usize begin, usize end, f32 deltatime);
+    usize locate(usize id);
+    void assign_path(usize id, const std::vector<CrossInfo>& corridor, Vector2f goal);
+    void run_replans();
+
+public:
+    Crowd(const nav::Mesh* mesh);
+
+    std::optional<usize> add(Vector2f pos, f32 speed = 1.f, f32 radius = 0.f);
+    void remove(usize id);
+    usize size() const;
+    bool is_active(usize id) const;
+
+    void set_speed(usize id, f32 speed);
+    f32 get_speed(usize id) const;
+    void set_radius(usize id, f32 radius);
+    f32 get_radius(usize id) const;
+
+    bool set_position(usize id, Vector2f pos);
+    Vector2f get_position(usize id) const;
+
+    bool set_target_position(usize id, Vector2f goal);
+    // queues a replan for the end of an update, the agent keeps its current path until then.
+    // higher priority is served first, e.g. urgency or negative distance to the camera
+    void request_target_position(usize id, Vector2f goal, f32 priority = 0.f);
+    usize pending_replans() const;
+    void set_replan_budget(const ReplanBudget& budget);
+    const ReplanBudget& get_replan_budget() const;
+    Vector2f get_target_position(usize id) const;
+
+    // moves a group with one corridor search from ids[0] to goal. every member walks that corridor to its own
+    // slot goal + offsets[i], only members whose start or slot is not on or next to the corridor search on their own.
+    // returns how many members got a path
+    usize set_group_target_position(const usize* ids, usize count, Vector2f goal, const Vector2f* offsets);
+    // slot offsets in rows around the origin, spacing apart
+    static void grid_formation(usize count, f32 spacing, std::vector<Vector2f>& offsets);
+
+    // index of the waypoint last passed, 0 being the position the path was planned from
+    size_t get_current_index(usize id) const;
+
+    Vector2f get_velocity(usize id) const;
+
+    bool is_moving(usize id) const;
+    void pause(usize id);
+    void stop(usize id);
+    void start(usize id);
+
+    // index over agent positions, refreshed at the end of every update
+    const SpatialHash& get_index() const;
+    // active agents within radius of p, unordered
+    void query_radius(Vector2f p, f32 radius, std::vector<usize>& result) const;
+    // up to k active agents closest to p, nearest first
+    void query_nearest(Vector2f p, usize k, std::vector<usize>& result, f32 max_radius = std::numeric_limits<f32>::infinity()) const;
+
+    void set_avoidance(const Avoidance& avoidance);
+    const Avoidance& get_avoidance() const;
+
+    void set_lod(const Lod& lod);
+    const Lod& get_lod() const;
+
+    void update(f32 deltatime);
+    // same as update, with the sweep split into cache aligned chunks across the pool.
+    // queued replans are still run serially once all chunks are done
+    void update(f32 deltatime, ThreadPool& pool);
+};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "mesh.h"
+#include "wallmask.h"
+#include <type_traits>
 
 
 namespace nav {
@@ -11,6 +13,26 @@ enum class Method {
     FLOODFILL,
 };
 
+enum class Simplifier {
+    DOUGLAS_PEUCKER,
+    VISVALINGAM_WHYATT,
+};
+
+// how outlines are thinned out before they are triangulated, in outline units (a tenth of a cell).
+// douglas-peucker drops the points within tolerance of the outline that is left. visvalingam-whyatt drops the
+// points spanning the smallest triangles with their neighbours until each one left spans more than tolerance,
+// and with a budget keeps going until no more than budget points are left over the whole map, or until no point
+// can go without the outlines crossing.
+// a plain epsilon is douglas-peucker
+struct Simplification {
+    Simplifier method = Simplifier::DOUGLAS_PEUCKER;
+    f32 tolerance = 0.f;
+    usize budget = 0;
+
+    constexpr Simplification(f32 epsilon = 0.f) : tolerance(epsilon) {}
+    constexpr Simplification(Simplifier _method, f32 _tolerance, usize _budget = 0) : method(_method), tolerance(_tolerance), budget(_budget) {}
+};
+
 /*
 std::vector<IntTriangle> generate_earclip(
         const uint8_t* data,
@@ -23,6 +45,61 @@ std::vector<IntTriangle> generate_earclip(
     );
 */
 
+// traces the outlines of the floor in the mask with method, simplifies them and triangulates them
+Mesh triangulate_mask(const WallMask& mask, Method method, Simplification simplify, ThreadPool* pool);
+
+// cells are walls where predicate(cell) is true, it is handed a pointer to the first of the cell's stride bytes.
+// takes any lambda or functor and is built for it here, so the per cell call inlines into the scan of the grid
+template<typename F, std::enable_if_t<std::is_invocable_r_v<bool, F&, const u8*>, int> = 0>
+Mesh generate_delauney(
+        const u8* grid,
+        usize width,
+        usize height,
+        usize stride,
+        F&& predicate,
+        Method method,
+        Simplification simplify)
+{
+    return triangulate_mask(build_mask(grid, width, height, stride, predicate, nullptr), method, simplify, nullptr);
+}
+
+// the same, with every stage that splits into independent pieces spread over pool. the pool is the caller's
+// so its threads are started once, not on every regeneration
+template<typename F, std::enable_if_t<std::is_invocable_r_v<bool, F&, const u8*>, int> = 0>
+Mesh generate_delauney(
+        const u8* grid,
+        usize width,
+        usize height,
+        usize stride,
+        F&& predicate,
+        Method method,
+        Simplification simplify,
+        ThreadPool& pool)
+{
+    return triangulate_mask(build_mask(grid, width, height, stride, predicate, &pool), method, simplify, &pool);
+}
+
+Mesh generate_delauney(
+        const u8* grid,
+        usize width,
+        usize height,
+        usize stride,
+        Predicate P,
+        Method method,
+        Simplification simplify
+    );
+
+// walls are the cells whose byte at index is not zero
+Mesh generate_delauney(
+        const u8* grid,
+        usize width,
+        usize height,
+        usize stride,
+        usize index,
+        Method method,
+        Simplification simplify
+    );
+
 Mesh generate_delauney(
         const u8* grid,
         usize width,
@@ -30,7 +107,8 @@ Mesh generate_delauney(
         usize stride,
         Predicate P,
         Method method,
-        f32 epsilon
+        Simplification simplify,
+        ThreadPool& pool
     );
 
 Mesh generate_delauney(
@@ -40,13 +118,23 @@ Mesh generate_delauney(
         usize stride,
         usize index,
         Method method,
-        f32 epsilon
+        Simplification simplify,
+        ThreadPool& pool
+    );
+
+Mesh generate_from_shapes(
+        const std::vector<std::vector<Vector2f>>& polys,
+        const std::vector<FloatCircle>& circles,
+        const std::vector<Vector2f>& fillers,
+        u32 circle_res = 8,
+        f32 epsilon = 0.f
     );
 
 Mesh generate_from_shapes(
         const std::vector<std::vector<Vector2f>>& polys,
         const std::vector<FloatCircle>& circles,
         const std::vector<Vector2f>& fillers,
+        ThreadPool& pool,
         u32 circle_res = 8,
         f32 epsilon = 0.f
     );
@@ -4,26 +4,94 @@
 #include <filesystem>
 
 
+// the vendored BS::thread_pool<> is only declared here, so the public headers build without its include path.
+// code that creates a pool, or runs work on one, includes <BS_thread_pool.hpp> itself
+namespace BS {
+template<std::uint8_t>
+class thread_pool;
+}
+
 namespace nav {
 
+using ThreadPool = BS::thread_pool<0>;
+
+// one step of a triangle corridor: the triangle and which of its edges is crossed to leave it
+struct CrossInfo {
+    usize next_index;
+    usize neighbor_index;
+};
+
+// search and funnel buffers kept between queries, so repeated pathfinding does not allocate. not thread safe, use one per thread
+struct PathScratch {
+    std::vector<f32> g_cost;
+    std::vector<f32> f_cost;
+    std::vector<usize> parent;
+    std::vector<usize> via;
+    std::vector<Vector2f> entry;
+    std::vector<u32> visited;
+    u32 generation = 0;
+    std::vector<std::pair<f32, usize>> open;
+    std::vector<CrossInfo> corridor;
+    // triangles passed by the last trace that records them
+    std::vector<CrossInfo> traced;
+    std::vector<Vector2f> list_l;
+    std::vector<Vector2f> list_r;
+    // triangles expanded by the last corridor search
+    usize expanded = 0;
+
+    // shared scratch of the calling thread, used by the overloads that take none
+    static PathScratch& local();
+};
+
 struct Mesh {
     struct Edge {
         usize index;
         Vector2f center;
         usize a;
         usize b;
+        f32 width = 0.f;
     };
     std::vector<Vector2f> vertices;
     std::vector<Triangle> triangles;
     std::vector<std::vector<Edge>> edges;
 
+    // files carry a format version. files from before portal widths are read and given widths and clearance,
+    // unknown versions and short files read as an empty mesh
     void write_file(const std::filesystem::path& filename, f32 scale = 1.f) const;
     static Mesh read_file(const std::filesystem::path& filename, f32 scale = 1.f);
 
+    // sets each triangle's clearance from the widths of its portals
+    void bake_clearance();
+
     std::optional<size_t> get_triangle(Vector2f p, f32 error = 0.f) const;
 
-    Path pathfind(Vector2f begin, Vector2f end) const;
-    IndexedPath pathfind_indexed(Vector2f begin, Vector2f end) const;
+    // true if the segment stays inside the mesh, i.e. no wall is crossed
+    bool raycast(Vector2f begin, Vector2f end) const;
+    bool raycast(usize begin_tri, Vector2f begin, Vector2f end) const;
+    // triangle containing end, found by walking portals from begin_tri. empty if a wall is in the way
+    std::optional<size_t> trace(usize begin_tri, Vector2f begin, Vector2f end) const;
+    // same walk, recording the triangles passed through as a corridor
+    bool trace(usize begin_tri, Vector2f begin, Vector2f end, std::vector<CrossInfo>& visited) const;
+    // results[i] is set to raycast(begins[i], ends[i]), queries are processed grouped by start triangle.
+    // every distinct start is looked up with get_triangle, a scan of the mesh
+    void raycast_batch(const Vector2f* begins, const Vector2f* ends, usize count, u8* results) const;
+    void raycast_batch(const Vector2f* begins, const Vector2f* ends, usize count, u8* results, ThreadPool& pool) const;
+    // the same from known start triangles, such as the ones agents track, with no lookups
+    void raycast_batch(const usize* begin_tris, const Vector2f* begins, const Vector2f* ends, usize count, u8* results) const;
+    void raycast_batch(const usize* begin_tris, const Vector2f* begins, const Vector2f* ends, usize count, u8* results, ThreadPool& pool) const;
+
+    // portals narrower than 2 * radius are never crossed, funnel corners keep radius distance from walls
+    Path pathfind(Vector2f begin, Vector2f end, f32 radius = 0.f) const;
+    // fills scratch.corridor with the triangles crossed from begin to end
+    bool find_corridor(Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius = 0.f) const;
+    bool find_corridor(usize begin_tri, Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius = 0.f) const;
+    // from known start and goal triangles, with no lookups
+    bool find_corridor(usize begin_tri, usize end_tri, Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius = 0.f) const;
+    // writes the waypoints into result, reusing its capacity and the buffers in scratch
+    bool pathfind(Vector2f begin, Vector2f end, Path& result, PathScratch& scratch, f32 radius = 0.f) const;
+    // same as pathfind, but every waypoint also carries the triangle the path continues through
+    IndexedPath pathfind_indexed(Vector2f begin, Vector2f end, f32 radius = 0.f) const;
+    bool pathfind_indexed(Vector2f begin, Vector2f end, IndexedPath& result, PathScratch& scratch, f32 radius = 0.f) const;
 };
 
 }
@@ -0,0 +1,38 @@
+#pragma once
+#include "mesh.h"
+
+
+namespace nav {
+
+// holds a triangle corridor and string-pulls it one corner at a time,
+// so the funnel only runs for the part of the path that is actually walked
+class LazyPath {
+private:
+    const Mesh* p_mesh = nullptr;
+    std::vector<CrossInfo> m_corridor;
+    Vector2f m_root;
+    Vector2f m_end;
+    f32 m_radius = 0.f;
+    usize m_apex = 0;
+    bool m_resume_r = false;
+    bool m_done = true;
+
+    Vector2f portal_l(usize i) const;
+    Vector2f portal_r(usize i) const;
+
+public:
+    void assign(const Mesh* mesh, const std::vector<CrossInfo>& corridor, Vector2f begin, Vector2f end, f32 radius = 0.f);
+    void clear();
+
+    bool is_done() const;
+    Vector2f get_end() const;
+    const std::vector<CrossInfo>& get_corridor() const;
+
+    // next corner of the funnelled path, the last one returned is the end point
+    Vector2f next();
+    // next() paired with the corridor triangle the path continues through from that corner
+    IndexedPoint next_indexed();
+    void drain(Path& result);
+};
+
+}
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <vector>
 #include "core.h"
+#include "smallvec.h"
 
 
 namespace nav {
@@ -56,6 +57,7 @@ struct Triangle {
     usize B;
     usize C;
     f32 weight = 1.f;
+    f32 clearance = 0.f;
 
     constexpr Vector2f centroid(const Vector2f* vertices) const {
         const auto a = vertices[A];
@@ -138,11 +140,12 @@ struct Triangle {
 };
 
 
-using Path = std::vector<Vector2f>;
+// most paths are a handful of corners, those never touch the heap
+using Path = SmallVec<Vector2f, 8>;
 struct IndexedPoint {
     Vector2f point;
     size_t index;
 };
-using IndexedPath = std::vector<IndexedPoint>;
+using IndexedPath = SmallVec<IndexedPoint, 8>;
 
 }
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "core.h"
+
+
+namespace nav {
+
+// vector with room for N elements inside the object itself, only longer contents go to the heap.
+// restricted to trivially copyable types so elements can be moved with memcpy
+template<typename T, usize N>
+class SmallVec {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVec only holds trivially copyable types");
+    static_assert(N > 0, "SmallVec needs an inline capacity");
+
+private:
+    T* m_data = inline_data();
+    usize m_size = 0;
+    usize m_capacity = N;
+    alignas(T) unsigned char m_inline[N * sizeof(T)];
+
+    T* inline_data() { return reinterpret_cast<T*>(m_inline); }
+    bool is_inline() const { return m_data == reinterpret_cast<const T*>(m_inline); }
+
+    void grow(usize capacity) {
+        auto data = (T*)std::malloc(capacity * sizeof(T));
+        if (!data) { throw std::bad_alloc(); }
+        if (m_size > 0) { std::memcpy((void*)data, (const void*)m_data, m_size * sizeof(T)); }
+        if (!is_inline()) { std::free(m_data); }
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    // doubles, or jumps straight to count when that is not enough
+    usize grown(usize count) const { return count > m_capacity * 2 ? count : m_capacity * 2; }
+
+    void copy_from(const SmallVec& other) {
+        reserve(other.m_size);
+        if (other.m_size > 0) { std::memcpy((void*)m_data, (const void*)other.m_data, other.m_size * sizeof(T)); }
+        m_size = other.m_size;
+    }
+
+    void move_from(SmallVec& other) {
+        if (other.is_inline()) {
+            copy_from(other);
+        } else {
+            if (!is_inline()) { std::free(m_data); }
+            m_data = other.m_data;
+            m_capacity = other.m_capacity;
+            m_size = other.m_size;
+            other.m_data = other.inline_data();
+            other.m_capacity = N;
+        }
+        other.m_size = 0;
+    }
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVec() = default;
+    SmallVec(std::initializer_list<T> init) { reserve(init.size()); for (const auto& v : init) { m_data[m_size++] = v; } }
+    explicit SmallVec(usize count, T value = T{}) { resize(count, value); }
+    SmallVec(const SmallVec& other) { copy_from(other); }
+    SmallVec(SmallVec&& other) noexcept { move_from(other); }
+    ~SmallVec() { if (!is_inline()) { std::free(m_data); } }
+
+    SmallVec& operator=(const SmallVec& other) { if (this != &other) { m_size = 0; copy_from(other); } return *this; }
+    SmallVec& operator=(SmallVec&& other) noexcept { if (this != &other) { m_size = 0; move_from(other); } return *this; }
+
+    usize size() const { return m_size; }
+    usize capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    T* begin() { return m_data; }
+    T* end() { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+    T& operator[](usize i) { return m_data[i]; }
+    const T& operator[](usize i) const { return m_data[i]; }
+    T& front() { return m_data[0]; }
+    const T& front() const { return m_data[0]; }
+    T& back() { return m_data[m_size - 1]; }
+    const T& back() const { return m_data[m_size - 1]; }
+
+    void reserve(usize capacity) { if (capacity > m_capacity) { grow(capacity); } }
+
+    void push_back(const T& value) {
+        if (m_size == m_capacity) {
+            const auto copy = value;
+            grow(grown(m_size + 1));
+            m_data[m_size++] = copy;
+        } else {
+            m_data[m_size++] = value;
+        }
+    }
+    template<typename... Args>
+    T& emplace_back(Args&&... args) { push_back(T{ std::forward<Args>(args)... }); return back(); }
+    void pop_back() { m_size--; }
+
+    void clear() { m_size = 0; }
+    void resize(usize count, T value = T{}) {
+        if (count > m_capacity) { grow(grown(count)); }
+        for (usize i = m_size; i < count; i++) { m_data[i] = value; }
+        m_size = count;
+    }
+};
+
+}
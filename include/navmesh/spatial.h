@@ -0,0 +1,149 @@
+#pragma once
+#include "shapes.h"
+#include <algorithm>
+#include <limits>
+
+
+namespace nav {
+
+// hashed uniform grid over item ids, rebuilt with a counting sort so buckets are contiguous runs of ids.
+// point builds also keep the positions in bucket order, which the exact radius and nearest queries scan
+class SpatialHash {
+private:
+    f32 m_cell = 1.f;
+    u32 m_mask = 0;
+    std::vector<u32> m_start;
+    std::vector<u32> m_items;
+    std::vector<Vector2f> m_pos;
+    std::vector<u32> m_slot;
+    std::vector<u32> m_keys;
+    std::vector<u32> m_owner;
+
+    Vector2i cell_of(Vector2f p) const {
+        return Vector2i{ (i32)std::floor(p.x / m_cell), (i32)std::floor(p.y / m_cell) };
+    }
+    u32 bucket_of(Vector2i c) const {
+        return (u32)(((u32)c.x * 73856093u) ^ ((u32)c.y * 19349663u)) & m_mask;
+    }
+
+    void sort_keys(usize buckets);
+
+    // calls f(id, pos) for every point stored in exactly this cell, skipping others that share its bucket
+    template<typename F>
+    void scan_cell(Vector2i cell, F&& f) const {
+        const auto bucket = bucket_of(cell);
+        for (u32 i = m_start[bucket]; i < m_start[bucket + 1]; i++) {
+            if (cell_of(m_pos[i]) == cell) { f(m_items[i], m_pos[i]); }
+        }
+    }
+
+public:
+    // bucket count is rounded up to a power of two
+    SpatialHash(f32 cell_size = 4.f, usize buckets = 4096);
+
+    f32 get_cell_size() const { return m_cell; }
+
+    void build(const f32* xs, const f32* ys, usize count);
+    // for points that moved since the last build: only resorts when one of them changed cell
+    void update(const f32* xs, const f32* ys, usize count);
+    // segments are entered into every cell their bounding box touches
+    void build(const Vector2f* a, const Vector2f* b, usize count);
+
+    // calls f(id) for every item in the buckets touched by the circle, callers filter by exact distance.
+    // queries over at most 16 cells report a point item once, segment items may repeat
+    template<typename F>
+    void query(Vector2f p, f32 radius, F&& f) const {
+        if (m_items.empty()) { return; }
+        const auto lo = cell_of(Vector2f{ p.x - radius, p.y - radius });
+        const auto hi = cell_of(Vector2f{ p.x + radius, p.y + radius });
+        u32 seen[16];
+        usize seen_count = 0;
+        for (i32 y = lo.y; y <= hi.y; y++) {
+            for (i32 x = lo.x; x <= hi.x; x++) {
+                const auto bucket = bucket_of(Vector2i{ x, y });
+                // distinct cells can share a bucket, scan each bucket once for small queries
+                if (seen_count < 16) {
+                    if (std::find(seen, seen + seen_count, bucket) != seen + seen_count) { continue; }
+                    seen[seen_count++] = bucket;
+                }
+                for (u32 i = m_start[bucket]; i < m_start[bucket + 1]; i++) {
+                    f(m_items[i]);
+                }
+            }
+        }
+    }
+
+    // point builds only: ids within radius of p for which keep(id) holds, unordered
+    template<typename K>
+    void radius(Vector2f p, f32 radius, std::vector<usize>& result, K&& keep) const {
+        result.clear();
+        if (m_pos.empty()) { return; }
+        const auto lo = cell_of(Vector2f{ p.x - radius, p.y - radius });
+        const auto hi = cell_of(Vector2f{ p.x + radius, p.y + radius });
+        for (i32 y = lo.y; y <= hi.y; y++) {
+            for (i32 x = lo.x; x <= hi.x; x++) {
+                scan_cell(Vector2i{ x, y }, [&](u32 id, Vector2f pos){
+                    if ((pos - p).length_squared() <= radius * radius && keep(id)) { result.push_back(id); }
+                });
+            }
+        }
+    }
+    void radius(Vector2f p, f32 radius, std::vector<usize>& result) const {
+        this->radius(p, radius, result, [](usize){ return true; });
+    }
+
+    // point builds only: up to k ids closest to p within max_radius for which keep(id) holds, nearest first.
+    // searches rings of cells outwards and stops once no closer point can exist
+    template<typename K>
+    void nearest(Vector2f p, usize k, std::vector<usize>& result, f32 max_radius, K&& keep) const {
+        result.clear();
+        if (m_pos.empty() || k == 0) { return; }
+        thread_local auto best = std::vector<std::pair<f32, usize>>();
+        best.clear();
+
+        const auto max_sq = max_radius * max_radius;
+        const auto visit = [&](u32 id, Vector2f pos){
+            const auto d = (pos - p).length_squared();
+            if (d > max_sq || (best.size() == k && d >= best.front().first) || !keep(id)) { return; }
+            if (best.size() == k) {
+                std::pop_heap(best.begin(), best.end());
+                best.pop_back();
+            }
+            best.push_back({ d, id });
+            std::push_heap(best.begin(), best.end());
+        };
+
+        const auto c = cell_of(p);
+        // rings beyond this cannot hold a point within max_radius, or cover the whole occupied grid
+        const auto max_ring = max_radius < std::numeric_limits<f32>::infinity() ?
+            (i32)(max_radius / m_cell) + 1 :
+            std::numeric_limits<i32>::max();
+        usize scanned = 0;
+        for (i32 d = 0; d <= max_ring; d++) {
+            if (d == 0) {
+                scan_cell(c, [&](u32 id, Vector2f pos){ visit(id, pos); scanned++; });
+            } else {
+                for (i32 x = c.x - d; x <= c.x + d; x++) {
+                    scan_cell(Vector2i{ x, c.y - d }, [&](u32 id, Vector2f pos){ visit(id, pos); scanned++; });
+                    scan_cell(Vector2i{ x, c.y + d }, [&](u32 id, Vector2f pos){ visit(id, pos); scanned++; });
+                }
+                for (i32 y = c.y - d + 1; y <= c.y + d - 1; y++) {
+                    scan_cell(Vector2i{ c.x - d, y }, [&](u32 id, Vector2f pos){ visit(id, pos); scanned++; });
+                    scan_cell(Vector2i{ c.x + d, y }, [&](u32 id, Vector2f pos){ visit(id, pos); scanned++; });
+                }
+            }
+            // anything in ring d + 1 is at least d cells away
+            const auto ring_dist = (f32)d * m_cell;
+            if (best.size() == k && best.front().first <= ring_dist * ring_dist) { break; }
+            if (scanned == m_pos.size()) { break; }
+        }
+
+        std::sort_heap(best.begin(), best.end());
+        for (const auto& [d, id] : best) { result.push_back(id); }
+    }
+    void nearest(Vector2f p, usize k, std::vector<usize>& result, f32 max_radius = std::numeric_limits<f32>::infinity()) const {
+        nearest(p, k, result, max_radius, [](usize){ return true; });
+    }
+};
+
+}
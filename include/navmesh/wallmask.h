@@ -0,0 +1,80 @@
+#pragma once
+#include "mesh.h"
+#include <functional>
+
+
+namespace nav {
+
+// rows per task when height rows of width cells are split over the pool: a few tasks per thread so uneven rows
+// even out, but never less work per task than it costs to hand it over
+usize band_rows(usize width, usize height, const ThreadPool& pool);
+// runs fill(lo, hi) on pool for every band of block rows out of rows, and waits for all of them
+void run_bands(usize rows, usize block, ThreadPool& pool, const std::function<void(usize, usize)>& fill);
+
+
+// one bit per cell, set for walls. it has a border of wall cells all around so every cell and marching square
+// has real neighbours: row r holds grid row r-1, and bit c of a row holds column c-1
+struct WallMask {
+    usize width = 0;
+    usize height = 0;
+    usize words = 0;
+    usize rows = 0;
+    std::vector<u64> bits;
+
+    const u64* row(usize r) const { return bits.data() + r * words; }
+};
+
+// the predicate runs once per cell. whole words inside the grid are a fixed 64 calls with no border tests,
+// so an inlined predicate over a contiguous row can be vectorized
+template<typename F>
+WallMask build_mask(const u8* grid, usize width, usize height, usize stride, F&& is_wall, ThreadPool* pool) {
+    auto mask = WallMask();
+    mask.width = width;
+    mask.height = height;
+    mask.words = (width + 2 + 63) / 64;
+    mask.rows = height + 2;
+    mask.bits.resize(mask.words * mask.rows);
+
+    const auto fill_rows = [&](usize lo, usize hi) {
+        for (usize r = lo; r < hi; r++) {
+            auto* row = mask.bits.data() + r * mask.words;
+            if (r == 0 || r == height + 1) {
+                for (usize c = 0; c < width + 2; c++) { row[c / 64] |= (u64)1 << (c & 63); }
+                continue;
+            }
+            const auto* cells = grid + (r - 1) * width * stride;
+            for (usize k = 0; k < mask.words; k++) {
+                const auto c0 = k * 64;
+                u64 word = 0;
+                if (c0 >= 1 && c0 + 63 <= width) {
+                    const auto* cell = cells + (c0 - 1) * stride;
+                    for (usize j = 0; j < 64; j++) { word |= (u64)(bool)is_wall(cell + j * stride) << j; }
+                } else {
+                    for (usize j = 0; j < 64; j++) {
+                        const auto c = c0 + j;
+                        const auto wall = c == 0 || c == width + 1 || (c <= width && is_wall(cells + (c - 1) * stride));
+                        word |= (u64)wall << j;
+                    }
+                }
+                row[k] = word;
+            }
+        }
+    };
+
+    // every row is its own run of words, so rows can be filled side by side
+    const auto block = pool ? band_rows(width, mask.rows, *pool) : mask.rows;
+    if (block < mask.rows) {
+        run_bands(mask.rows, block, *pool, fill_rows);
+    } else {
+        fill_rows(0, mask.rows);
+    }
+    return mask;
+}
+
+
+// outlines of the floor in the mask, in grid units times ten. marching squares cuts corners through the
+// middle of cells, floodfill follows cell sides. with a pool, rows are traced in bands side by side
+std::vector<Polygon> marching_squares(const WallMask& mask, ThreadPool* pool);
+std::vector<Polygon> floodfill(const WallMask& mask, ThreadPool* pool);
+
+}
@@ -1,4 +1,5 @@
 #include "agent.h"
+#include <algorithm>
 
 
 namespace nav {
@@ -6,6 +7,82 @@ namespace nav {
 Agent::Agent(const nav::Mesh* mesh) : p_mesh(mesh) {}
 
 
+void Agent::pull_path(size_t count) const {
+    while (m_path.size() < count && !m_lazy.is_done()) {
+        path_push(m_lazy.next());
+    }
+}
+
+void Agent::pull_path_to(float dist) const {
+    while (!m_lazy.is_done() && (m_path_dist.empty() || m_path_dist.back() <= dist)) {
+        path_push(m_lazy.next());
+    }
+}
+
+void Agent::path_push(Vector2f pos) const {
+    if (m_path.empty()) {
+        m_path_dist.push_back(0.f);
+    } else {
+        const auto diff = pos - m_path.back();
+        const auto len = diff.length();
+        m_path_dir.back() = len > 0.f ? diff * (1.f / len) : Vector2f{};
+        m_path_dist.push_back(m_path_dist.back() + len);
+    }
+    m_path.push_back(pos);
+    m_path_dir.push_back(Vector2f{});
+}
+
+void Agent::path_resize(size_t count) const {
+    m_path.resize(count);
+    m_path_dist.resize(count);
+    m_path_dir.resize(count);
+    if (count > 0) { m_path_dir.back() = Vector2f{}; }
+}
+
+void Agent::path_clear() const {
+    m_path.clear();
+    m_path_dist.clear();
+    m_path_dir.clear();
+}
+
+void Agent::move_to(Vector2f pos) {
+    if (m_triangle != SIZE_MAX) {
+        const auto tri = p_mesh->trace(m_triangle, m_position, pos);
+        m_triangle = tri.has_value() ? *tri : p_mesh->get_triangle(pos, 0.05f).value_or(m_triangle);
+    }
+    m_position = pos;
+}
+
+// drops the part of the corridor already walked, or bridges to it when the agent stepped into a neighbouring triangle
+bool Agent::patch_start(std::vector<CrossInfo>& corridor) const {
+    for (size_t i = corridor.size(); i-- > 0;) {
+        if (corridor[i].next_index == m_triangle) {
+            corridor.erase(corridor.begin(), corridor.begin() + i);
+            return true;
+        }
+    }
+    const auto& edges = p_mesh->edges[m_triangle];
+    for (size_t i = corridor.size(); i-- > 0;) {
+        for (size_t j = 0; j < edges.size(); j++) {
+            if (edges[j].index == corridor[i].next_index && edges[j].width >= 2.f * m_radius) {
+                corridor.erase(corridor.begin(), corridor.begin() + i);
+                corridor.insert(corridor.begin(), CrossInfo{ m_triangle, j });
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Agent::refunnel(const std::vector<CrossInfo>& corridor, Vector2f goal) {
+    m_lazy.assign(p_mesh, corridor, m_position, goal, m_radius);
+    path_clear();
+    path_push(m_position);
+    m_path_index = 0;
+    m_path_prog = 0;
+}
+
+
 void Agent::set_speed(float speed) {
     m_speed = speed;
 }
@@ -14,11 +91,25 @@ float Agent::get_speed() const {
     return m_speed;
 }
 
+void Agent::set_radius(float radius) {
+    m_radius = radius;
+}
+
+float Agent::get_radius() const {
+    return m_radius;
+}
+
 
 bool Agent::set_position(const Vector2f pos) {
-    if (!p_mesh->get_triangle(pos, 0.05f).has_value()) { return false; }
+    auto tri = std::optional<size_t>();
+    if (m_triangle != SIZE_MAX) { tri = p_mesh->trace(m_triangle, m_position, pos); }
+    if (!tri.has_value()) { tri = p_mesh->get_triangle(pos, 0.05f); }
+    if (!tri.has_value()) { return false; }
+    m_triangle = *tri;
     m_position = pos;
-    m_path.clear();
+    leave_table();
+    path_clear();
+    m_lazy.clear();
     m_path_index = 0;
     m_path_prog = 0;
     return true;
@@ -28,18 +119,151 @@ const Vector2f Agent::get_position() const {
     return m_position;
 }
 
+std::optional<size_t> Agent::get_current_triangle() const {
+    if (m_triangle == SIZE_MAX) { return {}; }
+    return m_triangle;
+}
+
 
 bool Agent::set_target_position(const Vector2f goal) {
-    m_path = p_mesh->pathfind(m_position, goal);
-    if (m_path.empty()) { return false; }
+    auto& scratch = PathScratch::local();
+    leave_table();
+    path_clear();
+    m_lazy.clear();
+    const auto found = m_triangle != SIZE_MAX
+        ? p_mesh->find_corridor(m_triangle, m_position, goal, scratch, m_radius)
+        : p_mesh->find_corridor(m_position, goal, scratch, m_radius);
+    if (!found) { return false; }
+    m_lazy.assign(p_mesh, scratch.corridor, m_position, goal, m_radius);
+    path_push(m_position);
+    m_path_index = 0;
+    m_path_prog = 0;
+    return true;
+}
+
+bool Agent::set_target_position(const Vector2f goal, ReservationTable& table) {
+    leave_table();
+    m_seat = TableSeat(table);
+    m_wait_slot = table.get_slot();
+    return plan_cooperative(goal);
+}
+
+bool Agent::plan_cooperative(const Vector2f goal) {
+    auto& scratch = PathScratch::local();
+    thread_local auto hold = std::vector<u32>();
+    path_clear();
+    m_lazy.clear();
     m_path_index = 0;
     m_path_prog = 0;
+    m_holds.clear();
+    const auto tri = m_triangle != SIZE_MAX ? std::optional<size_t>(m_triangle) : p_mesh->get_triangle(m_position, 0.05f);
+    if (!tri.has_value()) { return false; }
+    auto& table = *m_seat.get_table();
+    if (!table.plan(m_seat.get_owner(), *tri, m_position, goal, m_speed * 60.f, m_radius, scratch.corridor, hold)) { return false; }
+    for (size_t i = 0; i < hold.size(); i++) {
+        if (hold[i] > 0) { m_holds.push_back({ scratch.corridor[i].next_index, hold[i] }); }
+    }
+    m_plan_slot = table.get_slot();
+    refunnel(scratch.corridor, goal);
     return true;
 }
 
+bool Agent::is_held(size_t tri) const {
+    for (const auto& [t, slot] : m_holds) {
+        if (t == tri && slot > m_seat.get_table()->get_slot()) { return true; }
+    }
+    return false;
+}
+
+void Agent::leave_table() {
+    m_seat.leave();
+    m_holds.clear();
+}
+
+bool Agent::move_position(const Vector2f pos) {
+    if (m_triangle == SIZE_MAX) { return set_position(pos); }
+    const auto tri = p_mesh->trace(m_triangle, m_position, pos);
+    if (!tri.has_value()) { return false; }
+    m_triangle = *tri;
+    m_position = pos;
+    if (m_path.empty()) { return true; }
+
+    const auto goal = m_lazy.get_end();
+    auto& corridor = PathScratch::local().corridor;
+    corridor = m_lazy.get_corridor();
+    if (!patch_start(corridor)) { return set_target_position(goal); }
+    refunnel(corridor, goal);
+    return true;
+}
+
+bool Agent::move_target_position(const Vector2f goal) {
+    if (m_path.empty() || m_triangle == SIZE_MAX) { return set_target_position(goal); }
+    auto& corridor = PathScratch::local().corridor;
+    corridor = m_lazy.get_corridor();
+    if (!patch_start(corridor)) { return set_target_position(goal); }
+
+    // the goal either stayed inside the corridor or moved one triangle past its end
+    auto patched = false;
+    for (size_t i = corridor.size(); i-- > 0;) {
+        if (p_mesh->triangles[corridor[i].next_index].contains(p_mesh->vertices.data(), goal)) {
+            corridor.resize(i + 1);
+            corridor.back().neighbor_index = SIZE_MAX;
+            patched = true;
+            break;
+        }
+    }
+    if (!patched) {
+        const auto& edges = p_mesh->edges[corridor.back().next_index];
+        for (size_t j = 0; j < edges.size(); j++) {
+            const auto& tri = p_mesh->triangles[edges[j].index];
+            if (edges[j].width >= 2.f * m_radius && tri.contains(p_mesh->vertices.data(), goal)) {
+                corridor.back().neighbor_index = j;
+                corridor.push_back(CrossInfo{ edges[j].index, SIZE_MAX });
+                patched = true;
+                break;
+            }
+        }
+    }
+    if (!patched) { return set_target_position(goal); }
+
+    refunnel(corridor, goal);
+    return true;
+}
+
+// shortcuts the start of the corridor when the corner after next is in plain sight
+void Agent::optimize_path() {
+    if (!is_moving() || m_triangle == SIZE_MAX) { return; }
+    pull_path(m_path_index + 3);
+    if (m_path_index + 2 >= m_path.size()) { return; }
+
+    auto& scratch = PathScratch::local();
+    auto& visited = scratch.traced;
+    if (!p_mesh->trace(m_triangle, m_position, m_path[m_path_index + 2], visited)) { return; }
+    for (size_t i = 0; i + 1 < visited.size(); i++) {
+        if (p_mesh->edges[visited[i].next_index][visited[i].neighbor_index].width < 2.f * m_radius) { return; }
+    }
+
+    const auto goal = m_lazy.get_end();
+    auto& corridor = scratch.corridor;
+    corridor = m_lazy.get_corridor();
+    for (size_t i = visited.size(); i-- > 0;) {
+        for (size_t j = corridor.size(); j-- > 0;) {
+            if (visited[i].next_index == corridor[j].next_index) {
+                visited.resize(i);
+                corridor.erase(corridor.begin(), corridor.begin() + j);
+                corridor.insert(corridor.begin(), visited.begin(), visited.end());
+                refunnel(corridor, goal);
+                return;
+            }
+        }
+    }
+}
+
 Vector2f Agent::get_target_position() const {
     if (m_path.empty()) {
         return m_position;
+    } else if (!m_lazy.is_done()) {
+        return m_lazy.get_end();
     } else {
         return m_path.back();
     }
@@ -66,6 +290,7 @@ static std::optional<float> ray_circle_intersect_nearest(nav::Vector2f p, nav::V
 
 void Agent::trim_path_radial(float dist) {
     if (dist == 0.f || m_path.empty()) { return; }
+    pull_path(SIZE_MAX);
     const auto last = m_path.back();
 
     for (size_t j = 0; j < m_path.size(); j++) {
@@ -75,12 +300,13 @@ void Agent::trim_path_radial(float dist) {
         if (d1 <= dist * dist) {
             const auto d2 = (m_path[i-1] - last).length_squared();
             if (d2 <= dist * dist) {
-                m_path.pop_back();
+                path_resize(i);
             } else {
                 const auto pos = m_path[i-1];
-                const auto dir = (m_path[i] - m_path[i-1]).normalise();
+                const auto dir = m_path_dir[i-1];
                 const auto circle = FloatCircle{ last, dist };
-                m_path[i] = pos + dir * ray_circle_intersect_nearest(pos, dir, circle).value();
+                path_resize(i);
+                path_push(pos + dir * ray_circle_intersect_nearest(pos, dir, circle).value());
                 return;
             }
         }
@@ -89,15 +315,11 @@ void Agent::trim_path_radial(float dist) {
 
 void Agent::trim_path_walked(float dist) {
     if (dist == 0.f || m_path.empty()) { return; }
-    auto total = 0.f;
-    for (int i = (int)m_path.size() - 2; i >= 0; i--) {
-        total += (m_path[i] - m_path[i+1]).length();
-        if (total < dist) {
-            m_path.pop_back();
-        } else {
-            break;
-        }
-    }
+    pull_path(SIZE_MAX);
+    // drop every waypoint closer than dist to the end, walking back along the path
+    const auto cut = m_path_dist.back() - dist;
+    const auto keep = std::upper_bound(m_path_dist.begin(), m_path_dist.end() - 1, cut) - m_path_dist.begin();
+    path_resize((size_t)keep + 1);
 }
 
 void Agent::clamp_path_radial(float dist) {
@@ -115,12 +337,13 @@ void Agent::clamp_path_radial(float dist) {
         if (d1 >= dist * dist) {
             const auto d2 = (m_path[i-1] - first).length_squared();
             if (d2 >= dist * dist) {
-                m_path.pop_back();
+                path_resize(i);
             } else {
                 const auto pos = m_path[i-1];
-                const auto dir = (m_path[i] - m_path[i-1]).normalise();
+                const auto dir = m_path_dir[i-1];
                 const auto circle = nav::FloatCircle{ first, dist };
-                m_path[i] = pos + dir * ray_circle_intersect_nearest(pos, dir, circle).value();
+                path_resize(i);
+                path_push(pos + dir * ray_circle_intersect_nearest(pos, dir, circle).value());
                 return;
             }
         }
@@ -129,33 +352,47 @@ void Agent::clamp_path_radial(float dist) {
 
 void Agent::clamp_path_walked(float dist) {
     if (m_path.empty()) { return; }
-    auto total = 0.f;
-    auto count = 1ULL;
-    auto step = 0.f;
-    for (size_t i = 0; i < m_path.size()-1 && total < dist; i++) {
-        step = (m_path[i+1] - m_path[i]).length();
-        total += step;
-        count++;
-    }
-    if (total <= dist) { return; }
-    if (count < 2) { m_path.clear(); return; }
-    m_path.resize(count);
-    const auto pos = m_path[m_path.size() - 2];
-    const auto dir = (m_path[m_path.size() - 1] - pos).normalise();
-    m_path.back() = pos + dir * (step - (total - dist));
+    pull_path(SIZE_MAX);
+    if (m_path_dist.back() <= dist) { return; }
+    if (dist <= 0.f) { path_clear(); return; }
+    const auto i = (size_t)(std::lower_bound(m_path_dist.begin(), m_path_dist.end(), dist) - m_path_dist.begin());
+    const auto pos = m_path[i-1] + m_path_dir[i-1] * (dist - m_path_dist[i-1]);
+    path_resize(i);
+    path_push(pos);
 }
 
 
 const nav::Path& Agent::get_active_path() const {
+    pull_path(SIZE_MAX);
     return m_path;
 }
 
 float Agent::get_active_path_length() const {
-    float result = 0.f;
-    for (size_t i = 0; i < m_path.size() - 1; i++) {
-        result += (m_path[i] - m_path[i+1]).length();
-    }
-    return result;
+    pull_path(SIZE_MAX);
+    return m_path_dist.empty() ? 0.f : m_path_dist.back();
+}
+
+float Agent::get_remaining_length() const {
+    pull_path(SIZE_MAX);
+    return m_path_dist.empty() ? 0.f : m_path_dist.back() - m_path_prog;
+}
+
+const nav::Path& Agent::get_funnelled_path() const {
+    return m_path;
+}
+
+float Agent::get_funnelled_length() const {
+    return m_path_dist.empty() ? 0.f : m_path_dist.back();
+}
+
+// point d along the active path, clamped to its ends
+Vector2f Agent::get_position_at(float dist) const {
+    pull_path_to(dist);
+    if (m_path.empty()) { return m_position; }
+    if (dist >= m_path_dist.back()) { return m_path.back(); }
+    if (dist <= 0.f) { return m_path.front(); }
+    const auto i = (size_t)(std::upper_bound(m_path_dist.begin(), m_path_dist.end(), dist) - m_path_dist.begin()) - 1;
+    return m_path[i] + m_path_dir[i] * (dist - m_path_dist[i]);
 }
 
 
@@ -164,12 +401,13 @@ size_t Agent::get_current_index() const {
 }
 
 size_t Agent::get_inverse_index() const {
+    pull_path(SIZE_MAX);
     return m_path.size() - 1 - m_path_index;
 }
 
 
 bool Agent::is_moving() const {
-    return !(m_path.empty() || (m_path_index == m_path.size() - 1) || m_override_stop);
+    return !(m_path.empty() || (m_path_index == m_path.size() - 1 && m_lazy.is_done()) || m_override_stop);
 }
 
 void Agent::pause() {
@@ -177,7 +415,8 @@ void Agent::pause() {
 }
 
 void Agent::stop()  {
-    m_override_stop = true; m_path.clear(); m_path_index = 0; m_path_prog = 0;
+    leave_table();
+    m_override_stop = true; path_clear(); m_lazy.clear(); m_path_index = 0; m_path_prog = 0;
 }
 
 void Agent::start() {
@@ -188,21 +427,37 @@ void Agent::start() {
 void Agent::update(float deltatime) {
     if (!is_moving()) { return; }
 
-    if (m_path[m_path_index + 1] == m_position) {
-        if (++m_path_index == m_path.size() - 1) { return; }
+    const auto step = m_speed * deltatime * 60.f;
+    if (auto* table = m_seat.get_table()) {
+        // plans only reserve a window ahead, so refresh them before running out of it. a plan still waiting
+        // on a hold is kept until the hold is over, replanning it would only push the wait back again
+        auto due = m_plan_slot + std::max(table->get_window() / 2, 1u);
+        for (const auto& [tri, slot] : m_holds) { due = std::max(due, slot); }
+        if (table->get_slot() >= due) {
+            if (!plan_cooperative(m_lazy.get_end())) { return; }
+        }
+        // wait at the border of a triangle the plan enters later. agents meeting head on in a narrow passage
+        // can keep each other waiting through every replan, so after a whole window of waiting it pushes on
+        if (!m_holds.empty() && table->get_slot() < m_wait_slot + table->get_window()) {
+            const auto tri = p_mesh->trace(m_triangle, m_position, get_position_at(m_path_prog + step));
+            if (tri.has_value() && *tri != m_triangle && is_held(*tri)) { return; }
+        }
+        m_wait_slot = table->get_slot();
     }
-    const auto diff = m_path[m_path_index + 1] - m_position;
-    const auto dist = diff.length();
-    const auto actual = m_speed * deltatime * 60.f;
-    if (dist < actual) {
+
+    // m_path_prog is the walked length, so moving is a lookup plus one multiply-add
+    m_path_prog += step;
+    pull_path_to(m_path_prog);
+    while (m_path_index + 1 < m_path.size() && m_path_dist[m_path_index + 1] <= m_path_prog) {
         m_path_index++;
-        m_position = m_path[m_path_index];
-        const auto dir = diff * (1.f / dist);
-        m_position += dir * (actual - dist);
-    } else {
-        const auto dir = diff * (1.f / dist);
-        m_position += dir * actual;
+        move_to(m_path[m_path_index]);
+    }
+    if (m_path_index + 1 >= m_path.size()) {
+        m_path_index = m_path.size() - 1;
+        m_path_prog = m_path_dist.back();
+        return;
     }
+    move_to(m_path[m_path_index] + m_path_dir[m_path_index] * (m_path_prog - m_path_dist[m_path_index]));
 }
 
 }
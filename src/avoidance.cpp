@@ -0,0 +1,160 @@
+#include "avoidance.h"
+#include <algorithm>
+
+
+namespace nav {
+
+// reciprocal velocity obstacles as in van den Berg et al., "Reciprocal n-body Collision Avoidance" (ORCA)
+
+static f32 det(Vector2f a, Vector2f b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+
+OrcaLine orca_agent_line(Vector2f rel_pos, Vector2f rel_vel, f32 combined_radius, f32 time_horizon, f32 deltatime, Vector2f velocity, f32 responsibility) {
+    const auto dist_sq = rel_pos.length_squared();
+    const auto combined_sq = combined_radius * combined_radius;
+    auto line = OrcaLine();
+    auto u = Vector2f{};
+
+    if (dist_sq > combined_sq) {
+        // no collision yet, project onto the truncated cone
+        const auto inv_horizon = 1.f / time_horizon;
+        const auto w = rel_vel - rel_pos * inv_horizon;
+        const auto w_len_sq = w.length_squared();
+        const auto dot = w.dot(rel_pos);
+
+        if (dot < 0.f && dot * dot > combined_sq * w_len_sq) {
+            // closest to the cutoff circle
+            const auto w_len = std::sqrt(w_len_sq);
+            const auto unit_w = w * (1.f / w_len);
+            line.direction = Vector2f{ unit_w.y, -unit_w.x };
+            u = unit_w * (combined_radius * inv_horizon - w_len);
+        } else {
+            // closest to one of the legs
+            const auto leg = std::sqrt(dist_sq - combined_sq);
+            if (det(rel_pos, w) > 0.f) {
+                line.direction = Vector2f{ rel_pos.x * leg - rel_pos.y * combined_radius, rel_pos.x * combined_radius + rel_pos.y * leg } * (1.f / dist_sq);
+            } else {
+                line.direction = Vector2f{ rel_pos.x * leg + rel_pos.y * combined_radius, -rel_pos.x * combined_radius + rel_pos.y * leg } * (-1.f / dist_sq);
+            }
+            u = line.direction * rel_vel.dot(line.direction) - rel_vel;
+        }
+    } else {
+        // already overlapping, resolve within this step
+        const auto inv_step = 1.f / deltatime;
+        const auto w = rel_vel - rel_pos * inv_step;
+        const auto w_len = w.length();
+        const auto unit_w = w_len > 0.f ? w * (1.f / w_len) : Vector2f{ 1.f, 0.f };
+        line.direction = Vector2f{ unit_w.y, -unit_w.x };
+        u = unit_w * (combined_radius * inv_step - w_len);
+    }
+
+    line.point = velocity + u * responsibility;
+    return line;
+}
+
+OrcaLine orca_wall_line(Vector2f pos, Vector2f closest, f32 radius, f32 time_horizon) {
+    const auto d = pos - closest;
+    const auto dist = d.length();
+    const auto n = dist > 0.f ? d * (1.f / dist) : Vector2f{ 0.f, 1.f };
+    // speed towards the wall is limited to closing the remaining gap within the horizon
+    return OrcaLine{ n * (-(dist - radius) / time_horizon), Vector2f{ n.y, -n.x } };
+}
+
+
+static bool linear_program1(const std::vector<OrcaLine>& lines, usize line_no, f32 radius, Vector2f opt, bool direction_opt, Vector2f& result) {
+    const auto& line = lines[line_no];
+    const auto dot = line.point.dot(line.direction);
+    const auto disc = dot * dot + radius * radius - line.point.length_squared();
+    if (disc < 0.f) { return false; }
+
+    const auto sqrt_disc = std::sqrt(disc);
+    auto t_left = -dot - sqrt_disc;
+    auto t_right = -dot + sqrt_disc;
+
+    for (usize i = 0; i < line_no; i++) {
+        const auto denom = det(line.direction, lines[i].direction);
+        const auto numer = det(lines[i].direction, line.point - lines[i].point);
+        if (std::abs(denom) <= 0.00001f) {
+            if (numer < 0.f) { return false; }
+            continue;
+        }
+        const auto t = numer / denom;
+        if (denom >= 0.f) {
+            t_right = std::min(t_right, t);
+        } else {
+            t_left = std::max(t_left, t);
+        }
+        if (t_left > t_right) { return false; }
+    }
+
+    if (direction_opt) {
+        result = line.point + line.direction * (opt.dot(line.direction) > 0.f ? t_right : t_left);
+    } else {
+        const auto t = line.direction.dot(opt - line.point);
+        result = line.point + line.direction * std::clamp(t, t_left, t_right);
+    }
+    return true;
+}
+
+static usize linear_program2(const std::vector<OrcaLine>& lines, f32 radius, Vector2f opt, bool direction_opt, Vector2f& result) {
+    if (direction_opt) {
+        result = opt * radius;
+    } else if (opt.length_squared() > radius * radius) {
+        result = opt.normalise() * radius;
+    } else {
+        result = opt;
+    }
+
+    for (usize i = 0; i < lines.size(); i++) {
+        if (det(lines[i].direction, lines[i].point - result) > 0.f) {
+            const auto temp = result;
+            if (!linear_program1(lines, i, radius, opt, direction_opt, result)) {
+                result = temp;
+                return i;
+            }
+        }
+    }
+    return lines.size();
+}
+
+static void linear_program3(const std::vector<OrcaLine>& lines, usize obstacle_count, usize begin, f32 radius, Vector2f& result) {
+    auto distance = 0.f;
+    auto proj = std::vector<OrcaLine>();
+
+    for (usize i = begin; i < lines.size(); i++) {
+        if (det(lines[i].direction, lines[i].point - result) <= distance) { continue; }
+
+        proj.assign(lines.begin(), lines.begin() + obstacle_count);
+        for (usize j = obstacle_count; j < i; j++) {
+            auto line = OrcaLine();
+            const auto d = det(lines[i].direction, lines[j].direction);
+            if (std::abs(d) <= 0.00001f) {
+                if (lines[i].direction.dot(lines[j].direction) > 0.f) { continue; }
+                line.point = (lines[i].point + lines[j].point) * 0.5f;
+            } else {
+                line.point = lines[i].point + lines[i].direction * (det(lines[j].direction, lines[i].point - lines[j].point) / d);
+            }
+            line.direction = (lines[j].direction - lines[i].direction).normalise();
+            proj.push_back(line);
+        }
+
+        const auto temp = result;
+        if (linear_program2(proj, radius, Vector2f{ -lines[i].direction.y, lines[i].direction.x }, true, result) < proj.size()) {
+            result = temp;
+        }
+        distance = det(lines[i].direction, lines[i].point - result);
+    }
+}
+
+Vector2f orca_solve(const std::vector<OrcaLine>& lines, usize obstacle_count, f32 max_speed, Vector2f preferred) {
+    auto result = Vector2f{};
+    const auto fail = linear_program2(lines, max_speed, preferred, false, result);
+    if (fail < lines.size()) {
+        linear_program3(lines, obstacle_count, fail, max_speed, result);
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "shapes.h"
+
+
+namespace nav {
+
+// velocities on the left of the directed line are permitted
+struct OrcaLine {
+    Vector2f point;
+    Vector2f direction;
+};
+
+// constraint from a neighbor agent, relative to the agent itself. responsibility is the share of the avoidance it takes on
+OrcaLine orca_agent_line(Vector2f rel_pos, Vector2f rel_vel, f32 combined_radius, f32 time_horizon, f32 deltatime, Vector2f velocity, f32 responsibility);
+// constraint keeping the agent out of a wall, closest is the point on the wall nearest to the agent
+OrcaLine orca_wall_line(Vector2f pos, Vector2f closest, f32 radius, f32 time_horizon);
+
+// velocity closest to preferred that satisfies all lines, the first obstacle_count lines are never relaxed
+Vector2f orca_solve(const std::vector<OrcaLine>& lines, usize obstacle_count, f32 max_speed, Vector2f preferred);
+
+}
@@ -0,0 +1,226 @@
+#include "cooperative.h"
+#include <algorithm>
+
+
+namespace nav {
+
+static float Chebyshev(Vector2f a, Vector2f b) { const auto d = Vector2f(b-a); return std::max(std::abs(d.x), std::abs(d.y)); }
+
+using OpenEntry = std::pair<f32, u32>;
+static bool open_cmp(const OpenEntry& a, const OpenEntry& b) { return a.first > b.first; }
+
+
+ReservationTable::ReservationTable(const Mesh* mesh, f32 slot_time, u32 window)
+    : p_mesh(mesh), m_slot_time(slot_time), m_window(window)
+{
+    m_inradius.reserve(mesh->triangles.size());
+    for (const auto& t : mesh->triangles) {
+        const auto a = mesh->vertices[t.A];
+        const auto b = mesh->vertices[t.B];
+        const auto c = mesh->vertices[t.C];
+        const auto area = std::abs((b - a).perp_cw().dot(c - a)) * 0.5f;
+        const auto perimeter = (b - a).length() + (c - b).length() + (a - c).length();
+        m_inradius.push_back(perimeter > 0.f ? 2.f * area / perimeter : 0.f);
+    }
+}
+
+
+void ReservationTable::advance(f32 deltatime) {
+    m_time += deltatime;
+    const auto slot = (u32)(m_time / m_slot_time);
+    if (slot == m_slot) { return; }
+    m_slot = slot;
+    for (auto it = m_slots.begin(); it != m_slots.end();) {
+        if ((u32)(it->first & 0xFFFFFFFF) < m_slot) {
+            it = m_slots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+u32 ReservationTable::get_slot() const {
+    return m_slot;
+}
+
+f32 ReservationTable::get_slot_time() const {
+    return m_slot_time;
+}
+
+u32 ReservationTable::get_window() const {
+    return m_window;
+}
+
+
+// side by side lanes of the agent's width across the triangle's incircle, so agents only pass each other
+// where there is room for it
+u32 ReservationTable::capacity(usize tri, f32 radius) const {
+    const auto lanes = m_inradius[tri] / std::max(radius, 0.05f);
+    return (u32)std::clamp(lanes, 1.f, 64.f);
+}
+
+usize ReservationTable::get_reserved(usize tri, u32 slot) const {
+    const auto it = m_slots.find(key(tri, slot));
+    return it == m_slots.end() ? 0 : it->second.size();
+}
+
+bool ReservationTable::is_free(usize tri, u32 slot, usize owner, f32 radius) const {
+    const auto it = m_slots.find(key(tri, slot));
+    if (it == m_slots.end()) { return true; }
+    u32 taken = 0;
+    for (const auto o : it->second) { taken += o != owner; }
+    return taken < capacity(tri, radius);
+}
+
+void ReservationTable::reserve(usize tri, u32 slot, usize owner) {
+    m_slots[key(tri, slot)].push_back(owner);
+    m_owned[owner].push_back(key(tri, slot));
+}
+
+usize ReservationTable::join() {
+    return m_next_owner++;
+}
+
+void ReservationTable::release(usize owner) {
+    const auto owned = m_owned.find(owner);
+    if (owned == m_owned.end()) { return; }
+    for (const auto k : owned->second) {
+        const auto it = m_slots.find(k);
+        if (it == m_slots.end()) { continue; }
+        auto& owners = it->second;
+        for (usize i = 0; i < owners.size();) {
+            if (owners[i] == owner) {
+                owners[i] = owners.back();
+                owners.pop_back();
+            } else {
+                i++;
+            }
+        }
+        if (owners.empty()) { m_slots.erase(it); }
+    }
+    m_owned.erase(owned);
+}
+
+
+bool ReservationTable::plan(usize owner, usize begin_tri, Vector2f begin, Vector2f end, f32 speed, f32 radius,
+                            std::vector<CrossInfo>& corridor, std::vector<u32>& hold)
+{
+    release(owner);
+    corridor.clear();
+    hold.clear();
+    if (speed <= 0.f) { return false; }
+
+    const auto& mesh = *p_mesh;
+    const auto end_idx = mesh.triangles[begin_tri].contains(mesh.vertices.data(), end) ? begin_tri : mesh.get_triangle(end, 0.f);
+    if (!end_idx.has_value()) { return false; }
+    const auto inv_speed = 1.f / speed;
+
+    m_nodes.clear();
+    m_open.clear();
+    m_best.clear();
+    // t is the slot relative to now, every state past the window collapses into t == window
+    const auto push = [&](usize tri, u32 t, f32 g, u32 parent, u32 edge, Vector2f entry) {
+        const auto k = key(tri, t);
+        const auto best = m_best.find(k);
+        if (best != m_best.end() && best->second <= g) { return; }
+        m_best[k] = g;
+        m_nodes.push_back(Node{ tri, t, g, parent, edge, entry });
+        m_open.push_back({ g + Chebyshev(entry, end) * inv_speed, (u32)m_nodes.size() - 1 });
+        std::push_heap(m_open.begin(), m_open.end(), open_cmp);
+    };
+    push(begin_tri, 0, 0.f, UINT32_MAX, UINT32_MAX, begin);
+
+    auto goal = UINT32_MAX;
+    while (!m_open.empty()) {
+        std::pop_heap(m_open.begin(), m_open.end(), open_cmp);
+        const auto current = m_open.back().second;
+        m_open.pop_back();
+        const auto n = m_nodes[current];
+        if (m_best[key(n.tri, n.t)] < n.g) { continue; }
+        if (n.tri == *end_idx) { goal = current; break; }
+
+        // the start triangle is where the agent already stands, it can always stay put there
+        if (n.t < m_window && (n.tri == begin_tri || is_free(n.tri, m_slot + n.t + 1, owner, radius))) {
+            push(n.tri, n.t + 1, (f32)(n.t + 1) * m_slot_time, current, UINT32_MAX, n.entry);
+        }
+
+        const auto& edges = mesh.edges[n.tri];
+        for (usize i = 0; i < edges.size(); i++) {
+            const auto& e = edges[i];
+            if (e.width < 2.f * radius) { continue; }
+            const auto g = n.g + (e.center - n.entry).length() * inv_speed;
+            const auto t = std::min(m_window, (u32)(g / m_slot_time));
+            // stays in its triangle until it crosses, then has to fit into the next one
+            auto open = t >= m_window || is_free(e.index, m_slot + t, owner, radius);
+            for (u32 s = n.t + 1; open && s <= t && s < m_window; s++) {
+                open = is_free(n.tri, m_slot + s, owner, radius);
+            }
+            if (open) { push(e.index, t, g, current, (u32)i, e.center); }
+        }
+    }
+    if (goal == UINT32_MAX) { return false; }
+
+    auto chain = std::vector<u32>();
+    for (auto i = goal; i != UINT32_MAX; i = m_nodes[i].parent) { chain.push_back(i); }
+    std::reverse(chain.begin(), chain.end());
+
+    auto enter = std::vector<u32>();
+    corridor.push_back(CrossInfo{ begin_tri, SIZE_MAX });
+    hold.push_back(0);
+    enter.push_back(0);
+    for (usize i = 1; i < chain.size(); i++) {
+        const auto& n = m_nodes[chain[i]];
+        if (n.edge == UINT32_MAX) { continue; }
+        corridor.back().neighbor_index = n.edge;
+        corridor.push_back(CrossInfo{ n.tri, SIZE_MAX });
+        hold.push_back(n.t > 0 && n.t < m_window ? m_slot + n.t : 0);
+        enter.push_back(n.t);
+    }
+
+    // each triangle from the slot it is entered until the next one is, the goal until the window ends
+    for (usize i = 0; i < corridor.size(); i++) {
+        const auto leave = i + 1 < corridor.size() ? enter[i+1] : m_window - 1;
+        for (u32 s = enter[i]; s <= leave && s < m_window; s++) {
+            reserve(corridor[i].next_index, m_slot + s, owner);
+        }
+    }
+    return true;
+}
+
+
+
+TableSeat::TableSeat(ReservationTable& table) : p_table(&table), m_owner(table.join()) {}
+
+TableSeat::TableSeat(TableSeat&& other) noexcept : p_table(other.p_table), m_owner(other.m_owner) {
+    other.p_table = nullptr;
+}
+
+TableSeat& TableSeat::operator=(TableSeat&& other) noexcept {
+    if (this != &other) {
+        leave();
+        p_table = other.p_table;
+        m_owner = other.m_owner;
+        other.p_table = nullptr;
+    }
+    return *this;
+}
+
+TableSeat::~TableSeat() {
+    leave();
+}
+
+void TableSeat::leave() {
+    if (!p_table) { return; }
+    p_table->release(m_owner);
+    p_table = nullptr;
+}
+
+ReservationTable* TableSeat::get_table() const {
+    return p_table;
+}
+
+usize TableSeat::get_owner() const {
+    return m_owner;
+}
+
+}
@@ -0,0 +1,655 @@
+#include "crowd.h"
+#include <BS_thread_pool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include "avoidance.h"
+
+
+namespace nav {
+
+// triangle sides that are not a portal to a neighbor
+static void collect_walls(const Mesh& mesh, std::vector<Vector2f>& wall_a, std::vector<Vector2f>& wall_b) {
+    for (usize i = 0; i < mesh.triangles.size(); i++) {
+        const auto& tri = mesh.triangles[i];
+        const usize sides[3][2] = { { tri.A, tri.B }, { tri.B, tri.C }, { tri.C, tri.A } };
+        for (const auto& side : sides) {
+            auto portal = false;
+            for (const auto& e : mesh.edges[i]) {
+                if ((e.a == side[0] && e.b == side[1]) || (e.a == side[1] && e.b == side[0])) { portal = true; break; }
+            }
+            if (!portal) {
+                wall_a.push_back(mesh.vertices[side[0]]);
+                wall_b.push_back(mesh.vertices[side[1]]);
+            }
+        }
+    }
+}
+
+// a point's place along a corridor: the step whose triangle holds it, or one next to that triangle.
+// edge is the side of corridor[step] leading to the point's triangle, SIZE_MAX when it is the corridor triangle itself
+struct CorridorHit {
+    usize step;
+    usize tri;
+    usize edge;
+};
+
+static std::optional<CorridorHit> locate_on_corridor(const Mesh& mesh, const std::vector<CrossInfo>& corridor, Vector2f p, f32 radius, bool latest) {
+    const auto count = corridor.size();
+    for (usize k = 0; k < count; k++) {
+        const auto step = latest ? count - 1 - k : k;
+        const auto tri = corridor[step].next_index;
+        if (mesh.triangles[tri].contains(mesh.vertices.data(), p)) { return CorridorHit{ step, tri, SIZE_MAX }; }
+    }
+    for (usize k = 0; k < count; k++) {
+        const auto step = latest ? count - 1 - k : k;
+        const auto& edges = mesh.edges[corridor[step].next_index];
+        for (usize j = 0; j < edges.size(); j++) {
+            const auto& tri = mesh.triangles[edges[j].index];
+            if (edges[j].width >= 2.f * radius && tri.contains(mesh.vertices.data(), p)) {
+                return CorridorHit{ step, edges[j].index, j };
+            }
+        }
+    }
+    return {};
+}
+
+// the part of corridor between two hits, bridged out to their triangles
+static bool slice_corridor(const Mesh& mesh, const std::vector<CrossInfo>& corridor, CorridorHit from, CorridorHit to, std::vector<CrossInfo>& result) {
+    result.clear();
+    if (from.tri == to.tri) { result.push_back(CrossInfo{ from.tri, SIZE_MAX }); return true; }
+    if (from.step > to.step) { return false; }
+    if (from.edge != SIZE_MAX) {
+        const auto& edges = mesh.edges[from.tri];
+        const auto back = corridor[from.step].next_index;
+        for (usize j = 0; j < edges.size(); j++) {
+            if (edges[j].index == back) { result.push_back(CrossInfo{ from.tri, j }); break; }
+        }
+    }
+    result.insert(result.end(), corridor.begin() + from.step, corridor.begin() + to.step + 1);
+    result.back().neighbor_index = to.edge;
+    if (to.edge != SIZE_MAX) { result.push_back(CrossInfo{ to.tri, SIZE_MAX }); }
+    return true;
+}
+
+static Vector2f closest_on_segment(Vector2f a, Vector2f b, Vector2f p) {
+    const auto ab = b - a;
+    const auto len_sq = ab.length_squared();
+    if (len_sq <= 0.f) { return a; }
+    return a + ab * std::clamp((p - a).dot(ab) / len_sq, 0.f, 1.f);
+}
+
+
+Crowd::Crowd(const nav::Mesh* mesh) : p_mesh(mesh) {
+    collect_walls(*mesh, m_wall_a, m_wall_b);
+    m_wall_hash.build(m_wall_a.data(), m_wall_b.data(), m_wall_a.size());
+}
+
+
+std::optional<usize> Crowd::add(Vector2f pos, f32 speed, f32 radius) {
+    const auto tri = p_mesh->get_triangle(pos, 0.05f);
+    if (!tri.has_value()) { return {}; }
+
+    usize id = 0;
+    if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+    } else {
+        id = m_flags.size();
+        m_pos_x.emplace_back();
+        m_pos_y.emplace_back();
+        m_next_x.emplace_back();
+        m_next_y.emplace_back();
+        m_vel_x.emplace_back();
+        m_vel_y.emplace_back();
+        m_avoid_x.emplace_back();
+        m_avoid_y.emplace_back();
+        m_speed.emplace_back();
+        m_carry.emplace_back();
+        m_lod_dt.emplace_back();
+        m_flags.emplace_back();
+        m_awake.resize(id / CacheAlignedAllocator<u8>::ALIGN + 1);
+        m_radius.emplace_back();
+        m_path_index.emplace_back();
+        m_paths.emplace_back();
+        m_goal.emplace_back();
+        m_priority.emplace_back();
+        m_triangle.emplace_back();
+        m_located.emplace_back();
+    }
+
+    m_pos_x[id] = pos.x;
+    m_pos_y[id] = pos.y;
+    m_next_x[id] = pos.x;
+    m_next_y[id] = pos.y;
+    m_vel_x[id] = 0.f;
+    m_vel_y[id] = 0.f;
+    m_speed[id] = speed;
+    m_carry[id] = 0.f;
+    m_lod_dt[id] = 0.f;
+    set_flags(id, ACTIVE);
+    m_radius[id] = radius;
+    m_path_index[id] = 0;
+    m_paths[id].clear();
+    m_triangle[id] = *tri;
+    m_located[id] = pos;
+    return id;
+}
+
+void Crowd::remove(usize id) {
+    // the slot is already on the free list, pushing it again would hand it out twice
+    if (!(m_flags[id] & ACTIVE)) { return; }
+    set_flags(id, 0);
+    m_paths[id].clear();
+    m_free.push_back(id);
+}
+
+usize Crowd::size() const {
+    return m_flags.size();
+}
+
+bool Crowd::is_active(usize id) const {
+    return m_flags[id] & ACTIVE;
+}
+
+
+void Crowd::set_speed(usize id, f32 speed) {
+    m_speed[id] = speed;
+}
+
+f32 Crowd::get_speed(usize id) const {
+    return m_speed[id];
+}
+
+void Crowd::set_radius(usize id, f32 radius) {
+    m_radius[id] = radius;
+}
+
+f32 Crowd::get_radius(usize id) const {
+    return m_radius[id];
+}
+
+
+bool Crowd::set_position(usize id, Vector2f pos) {
+    const auto tri = p_mesh->get_triangle(pos, 0.05f);
+    if (!tri.has_value()) { return false; }
+    m_pos_x[id] = pos.x;
+    m_pos_y[id] = pos.y;
+    m_next_x[id] = pos.x;
+    m_next_y[id] = pos.y;
+    set_flags(id, m_flags[id] & ~(MOVING | FINAL));
+    m_path_index[id] = 0;
+    m_paths[id].clear();
+    m_triangle[id] = *tri;
+    m_located[id] = pos;
+    return true;
+}
+
+Vector2f Crowd::get_position(usize id) const {
+    return Vector2f{ m_pos_x[id], m_pos_y[id] };
+}
+
+// the sweeps move agents without tracking their triangle, so it is traced from where the agent was last located.
+// that walks the few triangles in between, only an agent pushed off its line falls back to a lookup
+usize Crowd::locate(usize id) {
+    const auto pos = get_position(id);
+    const auto tri = p_mesh->trace(m_triangle[id], m_located[id], pos);
+    if (tri.has_value()) {
+        m_triangle[id] = *tri;
+    } else if (const auto found = p_mesh->get_triangle(pos, 0.05f); found.has_value()) {
+        m_triangle[id] = *found;
+    } else {
+        return SIZE_MAX;
+    }
+    m_located[id] = pos;
+    return m_triangle[id];
+}
+
+
+// an empty corridor leaves the agent standing
+void Crowd::assign_path(usize id, const std::vector<CrossInfo>& corridor, Vector2f goal) {
+    const auto pos = get_position(id);
+    set_flags(id, m_flags[id] & ~(MOVING | FINAL));
+    m_path_index[id] = 0;
+    m_paths[id].clear();
+    if (corridor.empty()) { return; }
+    m_paths[id].assign(p_mesh, corridor, pos, goal, m_radius[id]);
+    const auto next = m_paths[id].next();
+    m_next_x[id] = next.x;
+    m_next_y[id] = next.y;
+    set_flags(id, m_flags[id] | (m_paths[id].is_done() ? MOVING | FINAL : MOVING));
+}
+
+bool Crowd::set_target_position(usize id, Vector2f goal) {
+    auto& scratch = PathScratch::local();
+    m_flags[id] &= ~REPLAN;
+    const auto tri = locate(id);
+    const auto found = tri != SIZE_MAX && p_mesh->find_corridor(tri, get_position(id), goal, scratch, m_radius[id]);
+    if (!found) { scratch.corridor.clear(); }
+    assign_path(id, scratch.corridor, goal);
+    return found;
+}
+
+usize Crowd::set_group_target_position(const usize* ids, usize count, Vector2f goal, const Vector2f* offsets) {
+    if (count == 0) { return 0; }
+    auto& scratch = PathScratch::local();
+    auto radius = 0.f;
+    for (usize i = 0; i < count; i++) { radius = std::max(radius, m_radius[ids[i]]); }
+
+    // wide enough for everyone, so members only ever narrow it down
+    auto corridor = std::vector<CrossInfo>();
+    const auto tri = locate(ids[0]);
+    if (tri != SIZE_MAX && p_mesh->find_corridor(tri, get_position(ids[0]), goal, scratch, radius)) { corridor = scratch.corridor; }
+
+    usize result = 0;
+    auto member = std::vector<CrossInfo>();
+    for (usize i = 0; i < count; i++) {
+        const auto id = ids[i];
+        const auto slot = goal + offsets[i];
+        const auto from = corridor.empty() ? std::nullopt : locate_on_corridor(*p_mesh, corridor, get_position(id), m_radius[id], true);
+        const auto to = corridor.empty() ? std::nullopt : locate_on_corridor(*p_mesh, corridor, slot, m_radius[id], false);
+
+        if (from && to && slice_corridor(*p_mesh, corridor, *from, *to, member)) {
+            m_flags[id] &= ~REPLAN;
+            assign_path(id, member, slot);
+            result++;
+        } else if (set_target_position(id, slot) || set_target_position(id, goal)) {
+            result++;
+        }
+    }
+    return result;
+}
+
+void Crowd::grid_formation(usize count, f32 spacing, std::vector<Vector2f>& offsets) {
+    offsets.clear();
+    const auto cols = (usize)std::ceil(std::sqrt((f32)count));
+    const auto rows = cols > 0 ? (count + cols - 1) / cols : 0;
+    for (usize i = 0; i < count; i++) {
+        const auto col = (f32)(i % cols) - (f32)(cols - 1) * 0.5f;
+        const auto row = (f32)(i / cols) - (f32)(rows - 1) * 0.5f;
+        offsets.push_back(Vector2f{ col * spacing, row * spacing });
+    }
+}
+
+void Crowd::request_target_position(usize id, Vector2f goal, f32 priority) {
+    m_goal[id] = goal;
+    m_priority[id] = priority;
+    if (!(m_flags[id] & REPLAN)) {
+        m_flags[id] |= REPLAN;
+        m_replans.push_back(id);
+    }
+}
+
+usize Crowd::pending_replans() const {
+    return m_replans.size();
+}
+
+void Crowd::set_replan_budget(const ReplanBudget& budget) {
+    m_budget = budget;
+}
+
+const Crowd::ReplanBudget& Crowd::get_replan_budget() const {
+    return m_budget;
+}
+
+Vector2f Crowd::get_target_position(usize id) const {
+    if (m_flags[id] & MOVING) {
+        return m_paths[id].get_end();
+    } else {
+        return get_position(id);
+    }
+}
+
+
+size_t Crowd::get_current_index(usize id) const {
+    return m_path_index[id];
+}
+
+
+Vector2f Crowd::get_velocity(usize id) const {
+    return Vector2f{ m_vel_x[id], m_vel_y[id] };
+}
+
+
+bool Crowd::is_moving(usize id) const {
+    return (m_flags[id] & (MOVING | PAUSED)) == MOVING;
+}
+
+void Crowd::pause(usize id) {
+    set_flags(id, m_flags[id] | PAUSED);
+}
+
+void Crowd::stop(usize id) {
+    set_flags(id, (m_flags[id] | PAUSED) & ~(MOVING | FINAL | REPLAN));
+    m_path_index[id] = 0;
+    m_paths[id].clear();
+}
+
+void Crowd::start(usize id) {
+    set_flags(id, m_flags[id] & ~PAUSED);
+}
+
+
+// keeps the per line count of moving agents in step. agents that stop moving sleep with zero velocity
+void Crowd::set_flags(usize id, u8 flags) {
+    const auto was = (m_flags[id] & (MOVING | PAUSED)) == MOVING;
+    const auto now = (flags & (MOVING | PAUSED)) == MOVING;
+    m_flags[id] = flags;
+    if (was == now) { return; }
+    auto& awake = m_awake[id / CacheAlignedAllocator<u8>::ALIGN];
+    awake = now ? awake + 1 : awake - 1;
+    m_lod_dt[id] = 0.f;
+    if (!now) {
+        m_vel_x[id] = 0.f;
+        m_vel_y[id] = 0.f;
+    }
+}
+
+bool Crowd::is_far(usize id) const {
+    const auto dx = m_pos_x[id] - m_lod.focus.x;
+    const auto dy = m_pos_y[id] - m_lod.focus.y;
+    return dx * dx + dy * dy > m_lod.far_dist * m_lod.far_dist;
+}
+
+// the waypoint was reached this tick: spend the leftover distance on the following ones,
+// which may pass several waypoints when a far agent catches up on skipped time
+void Crowd::advance(usize id) {
+    while (true) {
+        m_path_index[id]++;
+        if (m_paths[id].is_done()) {
+            set_flags(id, m_flags[id] & ~(MOVING | FINAL));
+            return;
+        }
+        const auto next = m_paths[id].next();
+        m_next_x[id] = next.x;
+        m_next_y[id] = next.y;
+        if (m_paths[id].is_done()) { m_flags[id] |= FINAL; }
+
+        const auto dx = next.x - m_pos_x[id];
+        const auto dy = next.y - m_pos_y[id];
+        const auto dist = std::sqrt(dx * dx + dy * dy);
+        if (dist > m_carry[id]) {
+            const auto t = m_carry[id] / dist;
+            m_pos_x[id] += dx * t;
+            m_pos_y[id] += dy * t;
+            return;
+        }
+        m_pos_x[id] = next.x;
+        m_pos_y[id] = next.y;
+        m_carry[id] -= dist;
+    }
+}
+
+const SpatialHash& Crowd::get_index() const {
+    return m_agent_hash;
+}
+
+void Crowd::query_radius(Vector2f p, f32 radius, std::vector<usize>& result) const {
+    m_agent_hash.radius(p, radius, result, [&](usize id){ return (bool)(m_flags[id] & ACTIVE); });
+}
+
+void Crowd::query_nearest(Vector2f p, usize k, std::vector<usize>& result, f32 max_radius) const {
+    m_agent_hash.nearest(p, k, result, max_radius, [&](usize id){ return (bool)(m_flags[id] & ACTIVE); });
+}
+
+
+void Crowd::set_avoidance(const Avoidance& avoidance) {
+    m_avoid = avoidance;
+}
+
+const Crowd::Avoidance& Crowd::get_avoidance() const {
+    return m_avoid;
+}
+
+void Crowd::set_lod(const Lod& lod) {
+    m_lod = lod;
+    m_lod.far_interval = std::max(lod.far_interval, 1u);
+}
+
+const Crowd::Lod& Crowd::get_lod() const {
+    return m_lod;
+}
+
+
+// reads positions and last velocities of all agents, writes only the avoidance velocity of [begin, end).
+// far agents do not avoid
+void Crowd::avoid_range(usize begin, usize end, f32 deltatime) {
+    constexpr usize LINE = CacheAlignedAllocator<u8>::ALIGN;
+    thread_local auto lines = std::vector<OrcaLine>();
+    thread_local auto neighbors = std::vector<usize>();
+
+    for (usize i = begin; i < end; i++) {
+        if (i % LINE == 0 && m_awake[i / LINE] == 0) {
+            i += LINE - 1;
+            continue;
+        }
+        if ((m_flags[i] & (MOVING | PAUSED)) != MOVING || is_far(i)) {
+            m_avoid_x[i] = 0.f;
+            m_avoid_y[i] = 0.f;
+            continue;
+        }
+
+        const auto pos = Vector2f{ m_pos_x[i], m_pos_y[i] };
+        const auto vel = Vector2f{ m_vel_x[i], m_vel_y[i] };
+        const auto to_next = Vector2f{ m_next_x[i], m_next_y[i] } - pos;
+        const auto dist = to_next.length();
+        const auto max_speed = m_speed[i] * 60.f;
+        // never aim past the waypoint within one step
+        const auto preferred = dist > 0.f ? to_next * (std::min(max_speed, dist / deltatime) / dist) : Vector2f{};
+
+        lines.clear();
+        const auto wall_range = m_radius[i] + max_speed * m_avoid.time_horizon_obst;
+        m_wall_hash.query(pos, wall_range, [&](u32 w){
+            const auto closest = closest_on_segment(m_wall_a[w], m_wall_b[w], pos);
+            if ((closest - pos).length_squared() < wall_range * wall_range) {
+                lines.push_back(orca_wall_line(pos, closest, m_radius[i], m_avoid.time_horizon_obst));
+            }
+        });
+        const auto obstacle_count = lines.size();
+
+        m_agent_hash.nearest(pos, m_avoid.max_neighbors, neighbors, m_avoid.neighbor_dist, [&](usize j){
+            return j != i && (m_flags[j] & ACTIVE);
+        });
+        for (const auto j : neighbors) {
+            const auto rel_pos = Vector2f{ m_pos_x[j], m_pos_y[j] } - pos;
+            const auto rel_vel = vel - Vector2f{ m_vel_x[j], m_vel_y[j] };
+            // idle neighbors will not step aside, so take the whole avoidance on
+            const auto share = (m_flags[j] & (MOVING | PAUSED)) == MOVING ? 0.5f : 1.f;
+            lines.push_back(orca_agent_line(rel_pos, rel_vel, m_radius[i] + m_radius[j], m_avoid.time_horizon, deltatime, vel, share));
+        }
+
+        const auto result = orca_solve(lines, obstacle_count, max_speed, preferred);
+        m_avoid_x[i] = result.x;
+        m_avoid_y[i] = result.y;
+    }
+}
+
+// per agent time step and mode for one cache line of agents. live and steer are 1 or 0: moving at all, and
+// following the avoidance velocity instead of heading straight for the corner
+struct LineStep {
+    alignas(CacheAlignedAllocator<u8>::ALIGN) f32 dt[CacheAlignedAllocator<u8>::ALIGN];
+    alignas(CacheAlignedAllocator<u8>::ALIGN) f32 live[CacheAlignedAllocator<u8>::ALIGN];
+    alignas(CacheAlignedAllocator<u8>::ALIGN) f32 steer[CacheAlignedAllocator<u8>::ALIGN];
+    alignas(CacheAlignedAllocator<u8>::ALIGN) f32 reach2[CacheAlignedAllocator<u8>::ALIGN];
+};
+
+// moves a line of agents with plain arithmetic and no branches: every agent runs all of it and keeps the
+// result that applies, idle and skipped agents get a step of zero. values read from the arrays are blended
+// with 0 and 1 factors rather than selected, and the arrays never overlap, so the loop can be vectorized
+// (gcc needs -fno-math-errno and -fno-trapping-math, as with -ffast-math)
+static void step_line(usize n, f32 deltatime, const LineStep& line,
+                      f32* __restrict pos_x, f32* __restrict pos_y, f32* __restrict vel_x, f32* __restrict vel_y,
+                      f32* __restrict carry, const f32* __restrict next_x, const f32* __restrict next_y,
+                      const f32* __restrict avoid_x, const f32* __restrict avoid_y, const f32* __restrict speed) {
+    for (usize k = 0; k < n; k++) {
+        const auto dt = line.dt[k];
+        const auto steer = line.steer[k];
+        const auto dx = next_x[k] - pos_x[k];
+        const auto dy = next_y[k] - pos_y[k];
+        const auto dist = std::sqrt(dx * dx + dy * dy);
+        const auto step = line.live[k] * speed[k] * dt * 60.f;
+        const auto t = std::min(step / std::max(dist, 1e-30f), 1.f);
+        // an agent skipped this update keeps its velocity
+        const auto inv_dt = 1.f / std::max(dt, 1e-30f);
+        const auto keep = dt > 0.f ? 0.f : 1.f;
+        const auto path_x = dx * t * inv_dt + vel_x[k] * keep;
+        const auto path_y = dy * t * inv_dt + vel_y[k] * keep;
+        const auto vx = avoid_x[k] * steer + path_x * (1.f - steer);
+        const auto vy = avoid_y[k] * steer + path_y * (1.f - steer);
+        pos_x[k] += steer > 0.f ? vx * deltatime : dx * t;
+        pos_y[k] += steer > 0.f ? vy * deltatime : dy * t;
+        vel_x[k] = vx;
+        vel_y[k] = vy;
+
+        // avoidance does not head straight for the corner, so it has reached it once close enough
+        const auto rx = next_x[k] - pos_x[k];
+        const auto ry = next_y[k] - pos_y[k];
+        const auto near = rx * rx + ry * ry <= line.reach2[k] ? 0.f : -1.f;
+        const auto left = line.live[k] * dt > 0.f ? step - dist : -1.f;
+        carry[k] = steer > 0.f ? near : left;
+    }
+}
+
+void Crowd::update_range(usize begin, usize end, f32 deltatime) {
+    constexpr usize LINE = CacheAlignedAllocator<u8>::ALIGN;
+    const auto avoid = m_avoid.neighbor_dist > 0.f;
+
+    for (usize lo = begin; lo < end; lo += LINE) {
+        const auto hi = std::min(end, lo + LINE);
+        // nobody in this line is moving, sleeping agents cost nothing until woken
+        if (m_awake[lo / LINE] == 0) { continue; }
+
+        // far agents only move every far_interval updates, catching up on the time they skipped. this pass
+        // settles each agent's time step and mode, so moving the line has nothing left to branch on
+        auto line = LineStep();
+        for (usize i = lo; i < hi; i++) {
+            const auto far = is_far(i);
+            const auto due = !far || (m_tick + i) % m_lod.far_interval == 0;
+            const auto moving = (m_flags[i] & (MOVING | PAUSED)) == MOVING;
+            m_lod_dt[i] += deltatime;
+            line.dt[i - lo] = due ? m_lod_dt[i] : 0.f;
+            m_lod_dt[i] = due ? 0.f : m_lod_dt[i];
+            line.live[i - lo] = moving ? 1.f : 0.f;
+            line.steer[i - lo] = avoid && !far ? 1.f : 0.f;
+            // corners are shared by everyone turning there, so with avoidance they count as reached within twice
+            // the agent radius, the goal itself within the radius. agents standing still never reach anything
+            const auto reach = std::max(m_flags[i] & FINAL ? m_radius[i] : 2.f * m_radius[i], 0.01f);
+            line.reach2[i - lo] = moving ? reach * reach : -1.f;
+        }
+
+        step_line(hi - lo, deltatime, line, m_pos_x.data() + lo, m_pos_y.data() + lo, m_vel_x.data() + lo,
+                  m_vel_y.data() + lo, m_carry.data() + lo, m_next_x.data() + lo, m_next_y.data() + lo,
+                  m_avoid_x.data() + lo, m_avoid_y.data() + lo, m_speed.data() + lo);
+
+        for (usize i = lo; i < hi; i++) {
+            if (m_carry[i] >= 0.f) { advance(i); }
+        }
+    }
+}
+
+// the only point where paths are searched during an update, always on the calling thread.
+// requests are served by priority, agents sharing a start and goal triangle share one search,
+// and whatever does not fit the budget stays queued for the next update. goal lookups scan the mesh,
+// so each goal is looked up once and a new one is only taken on while the budget lasts
+void Crowd::run_replans() {
+    if (m_replans.empty()) { return; }
+
+    struct Search {
+        f32 radius;
+        std::vector<CrossInfo> corridor;
+    };
+    auto searches = std::vector<Search>();
+    // searches by start and goal triangle, and goal triangles by the goal's bits
+    auto by_tris = std::unordered_map<u64, SmallVec<usize, 4>>();
+    auto goal_tris = std::unordered_map<u64, usize>();
+    auto& scratch = PathScratch::local();
+    const auto start = std::chrono::steady_clock::now();
+    usize expansions = 0;
+
+    const auto exhausted = [&]() {
+        const auto millis = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return !searches.empty() && ((m_budget.max_expansions > 0 && expansions >= m_budget.max_expansions) ||
+                                     (m_budget.max_millis > 0.f && millis >= m_budget.max_millis));
+    };
+
+    std::stable_sort(m_replans.begin(), m_replans.end(), [&](usize a, usize b){ return m_priority[a] > m_priority[b]; });
+
+    usize served = 0;
+    for (; served < m_replans.size(); served++) {
+        const auto id = m_replans[served];
+        if (!(m_flags[id] & REPLAN)) { continue; }
+        const auto pos = get_position(id);
+        const auto goal = m_goal[id];
+
+        u32 gx, gy;
+        std::memcpy(&gx, &goal.x, sizeof(u32));
+        std::memcpy(&gy, &goal.y, sizeof(u32));
+        auto known = goal_tris.find((u64)gx << 32 | gy);
+        if (known == goal_tris.end()) {
+            if (exhausted()) { break; }
+            known = goal_tris.emplace((u64)gx << 32 | gy, p_mesh->get_triangle(goal, 0.f).value_or(SIZE_MAX)).first;
+        }
+        const auto end_tri = known->second;
+        const auto begin_tri = locate(id);
+
+        auto& shared = by_tris[(u64)(u32)begin_tri << 32 | (u32)end_tri];
+        const Search* hit = nullptr;
+        for (const auto s : shared) {
+            if (searches[s].radius == m_radius[id]) { hit = &searches[s]; break; }
+        }
+        if (!hit) {
+            if (exhausted()) { break; }
+            scratch.corridor.clear();
+            if (begin_tri != SIZE_MAX && end_tri != SIZE_MAX) {
+                p_mesh->find_corridor(begin_tri, end_tri, pos, goal, scratch, m_radius[id]);
+                expansions += scratch.expanded;
+            }
+            shared.push_back(searches.size());
+            searches.push_back(Search{ m_radius[id], scratch.corridor });
+            hit = &searches.back();
+        }
+
+        m_flags[id] &= ~REPLAN;
+        assign_path(id, hit->corridor, goal);
+    }
+
+    m_replans.erase(m_replans.begin(), m_replans.begin() + served);
+}
+
+void Crowd::update(f32 deltatime) {
+    if (m_avoid.neighbor_dist > 0.f) {
+        m_agent_hash.update(m_pos_x.data(), m_pos_y.data(), m_flags.size());
+        avoid_range(0, m_flags.size(), deltatime);
+    }
+    update_range(0, m_flags.size(), deltatime);
+    run_replans();
+    m_tick++;
+    m_agent_hash.update(m_pos_x.data(), m_pos_y.data(), m_flags.size());
+}
+
+void Crowd::update(f32 deltatime, ThreadPool& pool) {
+    const auto count = m_flags.size();
+    // a few chunks per thread for balance, each a whole number of cache lines in every hot array
+    constexpr usize LINE = CacheAlignedAllocator<u8>::ALIGN;
+    const auto target = count / (pool.get_thread_count() * 4) + 1;
+    const auto chunk = ((target + LINE - 1) / LINE) * LINE;
+    const auto chunks = (count + chunk - 1) / chunk;
+
+    // every avoidance velocity has to be known before anyone moves
+    if (m_avoid.neighbor_dist > 0.f) {
+        m_agent_hash.update(m_pos_x.data(), m_pos_y.data(), count);
+        pool.submit_sequence((usize)0, chunks, [&](usize c){
+            avoid_range(c * chunk, std::min(count, (c + 1) * chunk), deltatime);
+        }).wait();
+    }
+
+    pool.submit_sequence((usize)0, chunks, [&](usize c){
+        update_range(c * chunk, std::min(count, (c + 1) * chunk), deltatime);
+    }).wait();
+    run_replans();
+    m_tick++;
+    m_agent_hash.update(m_pos_x.data(), m_pos_y.data(), count);
+}
+
+}
@@ -1,31 +1,12 @@
 #include "lib.h"
-#include "gen_internal.h"
-#include <unordered_map>
+#include "wallmask.h"
 #include <BS_thread_pool.hpp>
+#include <algorithm>
 
 #include "bench.h"
 
 namespace nav {
 
-struct Vector2iHash {
-    constexpr size_t operator()(const Vector2i& vec) const {
-        const size_t p1 = 73856093;
-        const size_t p2 = 19349663;
-        return ((size_t)vec.x * p1) ^ ((size_t)vec.y * p2);
-    }
-};
-
-template<typename T>
-struct Vector2Cmp {
-    constexpr bool operator()(const Vector2<T>& lhs, const Vector2<T>& rhs) const {
-        if (lhs.y > rhs.y) { return false; }
-        if (lhs.y < rhs.y) { return true; }
-        if (lhs.x < rhs.x) { return true; }
-        return false;
-    }
-};
-
-
 struct Contour {
     uint8_t count;
     Vector2i a;
@@ -59,285 +40,357 @@ constexpr static Contour MS_LUT[] = {
 };
 
 
-using EdgeMap = std::unordered_map<Vector2i, Vector2i, Vector2iHash>;
-
-static std::vector<Polygon> concat_edges(EdgeMap& map) {
-    auto shapes = std::vector<Polygon>();
-
-    while (!map.empty()) {
-        auto& chain = shapes.emplace_back();
-        chain.push_back(map.begin()->first);
-        chain.push_back(map.begin()->second);
-        map.erase(map.begin());
-        while (true) {
-            const auto it = map.find(chain.back());
-            if (it == map.end()) {
-                break;
-            } else if (it->second == chain.front()) {
-                chain.push_back(it->second);
-                map.erase(it);
-                break;
-            } else {
-                chain.push_back(it->second);
-                map.erase(it);
-            }
-        }
-    }
+using EdgeList = std::vector<std::pair<Vector2i, Vector2i>>;
 
-    return shapes;
+// b is a point in the middle of a straight line from a to c
+static bool straight(Vector2i a, Vector2i b, Vector2i c) {
+    const auto d1 = b - a;
+    const auto d2 = c - b;
+    return (i64)d1.x * d2.y == (i64)d1.y * d2.x && (i64)d1.x * d2.x + (i64)d1.y * d2.y > 0;
 }
 
-
-constexpr static u8 wall_lookup(const u8* grid, isize x, isize y, usize width, usize height, usize stride, Predicate P) {
-    if (x == -1 || y == -1) { return true; }
-    if (x == (isize)width || y == (isize)height) { return true; }
-    return (u8)P(grid + ((y * width + x) * stride));
+static bool row_major(Vector2i a, Vector2i b) {
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
 }
 
-constexpr static u8 wall_lookup(const u8* grid, isize x, isize y, usize width, usize height, usize stride, size_t index) {
-    if (x == -1 || y == -1) { return true; }
-    if (x == (isize)width || y == (isize)height) { return true; }
-    return grid[(y * width + x) * stride + index];
+// closed loops start on their top left point and all shapes are sorted by their points, so the result does
+// not depend on the order edges were linked in, nor on how a grid was split up
+static void canonical_order(std::vector<Polygon>& shapes) {
+    for (auto& shape : shapes) {
+        if (shape.size() < 2 || shape.front() != shape.back()) { continue; }
+        shape.pop_back();
+        std::rotate(shape.begin(), std::min_element(shape.begin(), shape.end(), row_major), shape.end());
+        shape.push_back(shape.front());
+    }
+    std::sort(shapes.begin(), shapes.end(), [](const Polygon& a, const Polygon& b){
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), row_major);
+    });
 }
 
 
-std::vector<Polygon> marching_squares(const uint8_t* data, size_t width, size_t height, size_t stride, Predicate P) {
-    auto edges = EdgeMap();
-
-    for (usize i = 0; i < (width + 2) * (height + 2); i++) {
-        const isize x = (isize)i % (isize)(width + 2) - 1;
-        const isize y = (isize)i / (isize)(width + 2) - 1;
+// chains edges into polygons without hashing their end points. extractors emit edges row by row, so an
+// edge only ever touches the few lattice lines around the current row: those lines are kept as flat arrays
+// mapping x to a vertex, and a line is recycled once the rows have moved past it.
+// every vertex gets exactly one edge in and one out, points touched twice (two cells meeting at a corner)
+// get a second vertex, so the result always falls apart into whole chains. a point with a straight edge on
+// both sides is dropped as soon as both are in, so straight walls come out as single edges
+class ContourLinker {
+private:
+    static constexpr u32 NONE = UINT32_MAX;
+    // lattice lines are 5 units apart, edges span at most 10 of them and rows only move forward
+    static constexpr usize LINES = 5;
+
+    struct Vertex {
+        Vector2i pos;
+        u32 next = NONE;
+        u32 prev = NONE;
+        u32 twin = NONE;
+        bool merged = false;
+    };
+
+    struct Line {
+        i32 y = INT32_MIN;
+        std::vector<u32> at;
+        std::vector<u32> touched;
+    };
+
+    std::vector<Vertex> m_vertices;
+    Line m_lines[LINES];
+    usize m_columns;
+
+    static usize lattice(i32 v) { return (usize)((v + 5) / 5); }
+
+    Line& line(i32 y) {
+        auto& l = m_lines[lattice(y) % LINES];
+        if (l.y != y) {
+            for (const auto x : l.touched) { l.at[x] = NONE; }
+            l.touched.clear();
+            l.y = y;
+        }
+        return l;
+    }
 
-        const u8 bits = (u8)(wall_lookup(data, x,   y,   width, height, stride, P) << 3) |
-                        (u8)(wall_lookup(data, x+1, y,   width, height, stride, P) << 2) |
-                        (u8)(wall_lookup(data, x+1, y+1, width, height, stride, P) << 1) |
-                        (u8)(wall_lookup(data, x,   y+1, width, height, stride, P));
-        const auto con = MS_LUT[bits];
-        if (con.count > 0) {
-            const auto a = Vector2i{ 10*(i32)x + con.a.x, 10*(i32)y + con.a.y };
-            const auto b = Vector2i{ 10*(i32)x + con.b.x, 10*(i32)y + con.b.y };
-            edges.emplace(a, b);
+    u32 vertex(Vector2i p) {
+        auto& l = line(p.y);
+        const auto x = lattice(p.x);
+        if (l.at[x] == NONE) {
+            l.at[x] = (u32)m_vertices.size();
+            l.touched.push_back((u32)x);
+            m_vertices.push_back(Vertex{ p });
         }
-        if (con.count > 2) {
-            const auto c = Vector2i{ 10*(i32)x + con.c.x, 10*(i32)y + con.c.y };
-            const auto d = Vector2i{ 10*(i32)x + con.d.x, 10*(i32)y + con.d.y };
-            edges.emplace(c, d);
+        return l.at[x];
+    }
+
+    template<typename F>
+    u32 free_vertex(Vector2i p, F&& is_free) {
+        auto v = vertex(p);
+        while (!is_free(m_vertices[v])) {
+            if (m_vertices[v].twin == NONE) {
+                m_vertices[v].twin = (u32)m_vertices.size();
+                m_vertices.push_back(Vertex{ p });
+            }
+            v = m_vertices[v].twin;
         }
+        return v;
     }
 
-    return concat_edges(edges);
-}
+    bool straight(u32 v) const {
+        const auto& m = m_vertices[v];
+        return nav::straight(m_vertices[m.prev].pos, m.pos, m_vertices[m.next].pos);
+    }
+
+    // the point keeps its links so it is never handed out again
+    void merge(u32 v) {
+        auto& m = m_vertices[v];
+        m_vertices[m.prev].next = m.next;
+        m_vertices[m.next].prev = m.prev;
+        m.merged = true;
+    }
+
+public:
+    // points lie in [-5, 10 * width + 5] along x
+    ContourLinker(usize width) : m_columns(2 * width + 3) {
+        for (auto& l : m_lines) { l.at.assign(m_columns, NONE); }
+    }
 
-std::vector<Polygon> marching_squares(const uint8_t* data, size_t width, size_t height, size_t stride, size_t index) {
-    auto edges = EdgeMap();
-
-    for (usize i = 0; i < (width + 2) * (height + 2); i++) {
-        const isize x = (isize)i % (isize)(width + 2) - 1;
-        const isize y = (isize)i / (isize)(width + 2) - 1;
-
-        const u8 bits = (u8)(wall_lookup(data, x,   y,   width, height, stride, index) << 3) |
-                        (u8)(wall_lookup(data, x+1, y,   width, height, stride, index) << 2) |
-                        (u8)(wall_lookup(data, x+1, y+1, width, height, stride, index) << 1) |
-                        (u8)(wall_lookup(data, x,   y+1, width, height, stride, index));
-        const auto con = MS_LUT[bits];
-        if (con.count > 0) {
-            const auto a = Vector2i{ 10*(i32)x + con.a.x, 10*(i32)y + con.a.y };
-            const auto b = Vector2i{ 10*(i32)x + con.b.x, 10*(i32)y + con.b.y };
-            edges.emplace(a, b);
+    void add(Vector2i a, Vector2i b) {
+        const auto from = free_vertex(a, [](const Vertex& v){ return v.next == NONE; });
+        const auto to = free_vertex(b, [](const Vertex& v){ return v.prev == NONE; });
+        m_vertices[from].next = to;
+        m_vertices[to].prev = from;
+        if (m_vertices[from].prev != NONE && straight(from)) { merge(from); }
+        if (m_vertices[to].next != NONE && straight(to)) { merge(to); }
+    }
+
+    // open chains first so none of them is cut up by starting in its middle, closed ones end on their first point
+    std::vector<Polygon> chains() {
+        auto shapes = std::vector<Polygon>();
+        auto done = std::vector<u8>(m_vertices.size(), 0);
+        const auto walk = [&](u32 v) {
+            auto& chain = shapes.emplace_back();
+            chain.push_back(m_vertices[v].pos);
+            done[v] = 1;
+            for (auto n = m_vertices[v].next; n != NONE; n = m_vertices[n].next) {
+                chain.push_back(m_vertices[n].pos);
+                if (done[n]) { break; }
+                done[n] = 1;
+            }
+        };
+        for (u32 v = 0; v < m_vertices.size(); v++) {
+            if (m_vertices[v].prev == NONE && m_vertices[v].next != NONE) { walk(v); }
         }
-        if (con.count > 2) {
-            const auto c = Vector2i{ 10*(i32)x + con.c.x, 10*(i32)y + con.c.y };
-            const auto d = Vector2i{ 10*(i32)x + con.d.x, 10*(i32)y + con.d.y };
-            edges.emplace(c, d);
+        for (u32 v = 0; v < m_vertices.size(); v++) {
+            if (!done[v] && !m_vertices[v].merged && m_vertices[v].next != NONE) { walk(v); }
         }
+        canonical_order(shapes);
+        return shapes;
     }
+};
+
 
-    return concat_edges(edges);
+static u32 lowest_bit(u64 word) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, word);
+    return (u32)i;
+#else
+    return (u32)__builtin_ctzll(word);
+#endif
 }
 
 
-std::vector<Polygon> floodfill(const uint8_t* data, size_t width, size_t height, size_t stride, Predicate P) {
-    auto result = EdgeMap();
-    u8 left = 0;
-    u8 right = 0;
+usize band_rows(usize width, usize height, const ThreadPool& pool) {
+    constexpr usize MIN_CELLS = 1 << 16;
+    const auto min_rows = MIN_CELLS / std::max(width, (usize)1) + 1;
+    const auto target = height / (pool.get_thread_count() * 4) + 1;
+    return std::max(target, min_rows);
+}
 
-    for (usize i = 0; i < width * height; i++) {
-        const isize x = i % width;
-        const isize y = i / width;
-        if (x == 0 || !right) {
-            left = 0;
-            right = !wall_lookup(data, x, y, width, height, stride, P);
-        }
+void run_bands(usize rows, usize block, ThreadPool& pool, const std::function<void(usize, usize)>& fill) {
+    pool.submit_blocks((usize)0, rows, fill, (rows + block - 1) / block).wait();
+}
 
-        if (right) {
-            if (wall_lookup(data, x, y-1, width, height, stride, P)) {
-                result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 });
-            }
-            if (!left) {
-                result.emplace(Vector2i{ (i32)x*10,      (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 + 10 });
-            }
-            if (wall_lookup(data, x, y+1, width, height, stride, P)) {
-                result.emplace(Vector2i{ (i32)x*10,      (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 });
+
+// the case code of 64 squares at once: each corner of a square is the same row word shifted by at most one bit.
+// squares that are all wall or all floor have no contour and are skipped without a lookup
+static void march_rows(const WallMask& mask, usize width, usize lo, usize hi, ContourLinker& edges) {
+    const auto squares = width + 1;
+
+    for (usize r = lo; r < hi; r++) {
+        const auto* top = mask.row(r);
+        const auto* bot = mask.row(r + 1);
+        const auto y = (i32)r - 1;
+        for (usize k = 0; k * 64 < squares; k++) {
+            const auto tl = top[k];
+            const auto bl = bot[k];
+            const auto tr = (tl >> 1) | (k + 1 < mask.words ? top[k+1] << 63 : 0);
+            const auto br = (bl >> 1) | (k + 1 < mask.words ? bot[k+1] << 63 : 0);
+            auto mixed = (tl | tr | br | bl) & ~(tl & tr & br & bl);
+            if (squares - k * 64 < 64) { mixed &= ((u64)1 << (squares - k * 64)) - 1; }
+
+            for (; mixed; mixed &= mixed - 1) {
+                const auto j = lowest_bit(mixed);
+                const auto bits = (u8)((((tl >> j) & 1) << 3) | (((tr >> j) & 1) << 2) | (((br >> j) & 1) << 1) | ((bl >> j) & 1));
+                const auto x = (i32)(k * 64 + j) - 1;
+                const auto con = MS_LUT[bits];
+                edges.add(Vector2i{ 10*x + con.a.x, 10*y + con.a.y }, Vector2i{ 10*x + con.b.x, 10*y + con.b.y });
+                if (con.count > 2) {
+                    edges.add(Vector2i{ 10*x + con.c.x, 10*y + con.c.y }, Vector2i{ 10*x + con.d.x, 10*y + con.d.y });
+                }
             }
-            if (wall_lookup(data, x+1, y, width, height, stride, P)) {
-                result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                right = 0;
+        }
+    }
+}
+
+// joins the open chains of neighbouring bands where they cross the seams between them. every seam point
+// ends exactly one chain and starts one other, and the joined loops are put in canonical order, so the
+// polygons are the same as from a single band
+static std::vector<Polygon> stitch(std::vector<std::vector<Polygon>>& bands) {
+    auto shapes = std::vector<Polygon>();
+    auto open = std::vector<Polygon*>();
+    for (auto& band : bands) {
+        for (auto& chain : band) {
+            if (chain.front() == chain.back()) {
+                shapes.push_back(std::move(chain));
             } else {
-                right = 1;
+                open.push_back(&chain);
             }
-            left = 1;
         }
     }
 
-    return concat_edges(result);
-}
+    auto starts = std::vector<std::pair<Vector2i, usize>>();
+    for (usize i = 0; i < open.size(); i++) { starts.push_back({ open[i]->front(), i }); }
+    const auto before = [](const std::pair<Vector2i, usize>& a, const std::pair<Vector2i, usize>& b) {
+        return row_major(a.first, b.first);
+    };
+    std::sort(starts.begin(), starts.end(), before);
+    const auto next = [&](usize i) {
+        const auto key = std::pair<Vector2i, usize>{ open[i]->back(), 0 };
+        const auto it = std::lower_bound(starts.begin(), starts.end(), key, before);
+        return it != starts.end() && it->first == key.first ? it->second : SIZE_MAX;
+    };
+
+    auto done = std::vector<u8>(open.size(), 0);
+    for (usize i = 0; i < open.size(); i++) {
+        if (done[i]) { continue; }
+        auto joined = Polygon();
+        auto c = i;
+        while (c != SIZE_MAX && !done[c]) {
+            done[c] = 1;
+            joined.insert(joined.end(), open[c]->begin() + (joined.empty() ? 0 : 1), open[c]->end());
+            c = next(c);
+        }
+        if (c != i) { shapes.push_back(std::move(joined)); continue; }
 
-std::vector<Polygon> floodfill(const u8* data, size_t width, size_t height, size_t stride, size_t index) {
-    auto result = EdgeMap();
-
-    for (usize i = 0; i < width * height; i++) {
-        const isize x = i % width;
-        const isize y = i / width;
-
-        if (!data[(y * width + x) * stride + index]) {
-            /*
-            if (y == 0               || data[((y-1) * width + x) * stride + index]) {
-                const auto it = result.find(Vector2i{ (i32)x*10, (i32)y*10 });
-                if (it != result.end() && it->second.y == y*10) {
-                    const auto v = it->second;
-                    result.erase(it);
-                    result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 }, v);
-                } else {
-                    result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 }, Vector2i{ (i32)x*10,      (i32)y*10 });
-                }
-            }
-            if (x == 0               || data[(y * width + (x-1)) * stride + index]) {
-                const auto it = result.find(Vector2i{ (i32)x*10, (i32)y*10 - 10 });
-                if (it != result.end() && it->second.x == x*10) {
-                    it->second = Vector2i{ (i32)x*10, (i32)y*10 + 10 };
-                } else {
-                    result.emplace(Vector2i{ (i32)x*10, (i32)y*10 }, Vector2i{ (i32)x*10, (i32)y*10 + 10 });
-                }
-            }
-            if (y == (isize)height-1 || data[((y+1) * width + x) * stride + index]) {
-                const auto it = result.find(Vector2i{ (i32)x*10 - 10, (i32)y*10 + 10 });
-                if (it != result.end() && it->second.y == y*10 + 10) {
-                    it->second = Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 };
-                } else {
-                    result.emplace(Vector2i{ (i32)x*10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 });
-                }
-            }
-            if (x == (isize)width-1  || data[(y * width + (x+1)) * stride + index]) {
-                const auto it = result.find(Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                if (it != result.end() && it->second.x == x*10 + 10) {
-                    const auto v = it->second;
-                    result.erase(it);
-                    result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, v);
-                } else {
-                    result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                }
-            }
-            */
-            if (y == 0               || data[((y-1) * width + x) * stride + index]) {
-                result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 });
-            }
-            if (x == 0               || data[(y * width + (x-1)) * stride + index]) {
-                result.emplace(Vector2i{ (i32)x*10,      (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 + 10 });
-            }
-            if (y == (isize)height-1 || data[((y+1) * width + x) * stride + index]) {
-                result.emplace(Vector2i{ (i32)x*10,      (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 });
-            }
-            if (x == (isize)width-1  || data[(y * width + (x+1)) * stride + index]) {
-                result.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-            }
+        // a seam crossed by a straight wall leaves a point in its middle, the single band never keeps those
+        auto& shape = shapes.emplace_back();
+        const auto n = joined.size() - 1;
+        for (usize k = 0; k < n; k++) {
+            if (!straight(joined[(k + n - 1) % n], joined[k], joined[k + 1])) { shape.push_back(joined[k]); }
         }
+        shape.push_back(shape.front());
     }
 
-    // std::cout << "==============" << result.size() << "\n";
+    canonical_order(shapes);
+    return shapes;
+}
+
+// bands of rows are traced side by side, each into its own linker, then stitched together
+std::vector<Polygon> marching_squares(const WallMask& mask, ThreadPool* pool) {
+    const auto width = mask.width;
+    const auto rows = mask.rows - 1;
+    const auto block = pool ? band_rows(width, rows, *pool) : rows;
+    if (block >= rows) {
+        auto edges = ContourLinker(width);
+        march_rows(mask, width, 0, rows, edges);
+        return edges.chains();
+    }
 
-    return concat_edges(result);
+    auto bands = pool->submit_sequence((usize)0, (rows + block - 1) / block, [&](usize i){
+        auto edges = ContourLinker(width);
+        march_rows(mask, width, i * block, std::min((i + 1) * block, rows), edges);
+        return edges.chains();
+    }).get();
+    return stitch(bands);
 }
 
 
-std::vector<Polygon> floodfill_threaded(const u8* data, size_t width, size_t height, size_t stride, size_t index) {
-    auto pool = BS::thread_pool();
-
-    const auto count = 8;
-    const auto len = width * height;
-    const auto block = ((isize)len / count);
-
-    auto future = pool.submit_sequence(0, count, [=](size_t i){
-        auto res = EdgeMap();
-        const auto begin = (isize)i * block;
-
-        for (isize j = begin; j < begin + block && j < (isize)len; j++) {
-            const isize x = j % width;
-            const isize y = j / width;
-            if (!data[(y * width + x) * stride + index]) {
-                /*
-                if (y == 0               || data[((y-1) * width + x) * stride + index]) {
-                    const auto it = res.find(Vector2i{ (i32)x*10, (i32)y*10 });
-                    if (it != res.end() && it->second.y == y*10) {
-                        const auto v = it->second;
-                        res.erase(it);
-                        res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 }, v);
-                    } else {
-                        res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 }, Vector2i{ (i32)x*10,      (i32)y*10 });
-                    }
-                }
-                if (x == 0               || data[(y * width + (x-1)) * stride + index]) {
-                    const auto it = res.find(Vector2i{ (i32)x*10, (i32)y*10 - 10 });
-                    if (it != res.end() && it->second == Vector2i{ (i32)x*10, (i32)y*10 }) {
-                        it->second = Vector2i{ (i32)x*10, (i32)y*10 + 10 };
-                    } else {
-                        res.emplace(Vector2i{ (i32)x*10, (i32)y*10 }, Vector2i{ (i32)x*10, (i32)y*10 + 10 });
-                    }
-                }
-                if (y == (isize)height-1 || data[((y+1) * width + x) * stride + index]) {
-                    const auto it = res.find(Vector2i{ (i32)x*10 - 10, (i32)y*10 + 10 });
-                    if (it != res.end() && it->second == Vector2i{ (i32)x*10, (i32)y*10 + 10 }) {
-                        it->second = Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 };
-                    } else {
-                        res.emplace(Vector2i{ (i32)x*10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 });
-                    }
-                }
-                if (x == (isize)width-1  || data[(y * width + (x+1)) * stride + index]) {
-                    const auto it = res.find(Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                    if (it != res.end() && it->second.x == x*10 + 10) {
-                        const auto v = it->second;
-                        res.erase(it);
-                        res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, v);
-                    } else {
-                        res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                    }
-                }
-                */
-                if (y == 0               || data[((y-1) * width + x) * stride + index]) {
-                    res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 });
-                }
-                if (x == 0               || data[(y * width + (x-1)) * stride + index]) {
-                    res.emplace(Vector2i{ (i32)x*10,      (i32)y*10 },      Vector2i{ (i32)x*10,      (i32)y*10 + 10 });
-                }
-                if (y == (isize)height-1 || data[((y+1) * width + x) * stride + index]) {
-                    res.emplace(Vector2i{ (i32)x*10,      (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 });
-                }
-                if (x == (isize)width-1  || data[(y * width + (x+1)) * stride + index]) {
-                    res.emplace(Vector2i{ (i32)x*10 + 10, (i32)y*10 + 10 }, Vector2i{ (i32)x*10 + 10, (i32)y*10 });
-                }
+// the outline of the floor cells in rows [lo, hi), cells outside the grid are walls. tops and bottoms come out
+// as whole runs along the row, sides one cell high for the linker to join up with the rows around them.
+// three rows of the mask are unpacked to bytes at a time
+template<typename E>
+static void flood_rows(const WallMask& mask, usize lo, usize hi, E&& emit) {
+    const auto width = mask.width;
+    auto rows = std::vector<u8>(3 * (width + 2), 1);
+    const auto fill = [&](u8* row, usize r) {
+        const auto* bits = mask.row(r);
+        for (usize c = 0; c < width + 2; c++) { row[c] = (u8)((bits[c / 64] >> (c & 63)) & 1); }
+    };
+    auto* above = rows.data();
+    auto* cur = above + width + 2;
+    auto* below = cur + width + 2;
+    fill(above, lo);
+    fill(cur, lo + 1);
+
+    for (usize y = lo; y < hi; y++) {
+        fill(below, y + 2);
+        const auto top = (i32)y * 10;
+        const auto bot = top + 10;
+
+        usize top_run = SIZE_MAX;
+        usize bot_run = SIZE_MAX;
+        for (usize c = 1; c <= width + 1; c++) {
+            const auto floor = !cur[c];
+            const auto x = (i32)c * 10 - 10;
+            if (floor && above[c]) {
+                if (top_run == SIZE_MAX) { top_run = c; }
+            } else if (top_run != SIZE_MAX) {
+                emit(Vector2i{ x, top }, Vector2i{ (i32)top_run * 10 - 10, top });
+                top_run = SIZE_MAX;
             }
+            if (floor && below[c]) {
+                if (bot_run == SIZE_MAX) { bot_run = c; }
+            } else if (bot_run != SIZE_MAX) {
+                emit(Vector2i{ (i32)bot_run * 10 - 10, bot }, Vector2i{ x, bot });
+                bot_run = SIZE_MAX;
+            }
+            if (c > width) { break; }
+            if (floor && cur[c-1]) { emit(Vector2i{ x,      top }, Vector2i{ x,      bot }); }
+            if (floor && cur[c+1]) { emit(Vector2i{ x + 10, bot }, Vector2i{ x + 10, top }); }
         }
 
-        return res;
-    });
+        const auto tmp = above;
+        above = cur;
+        cur = below;
+        below = tmp;
+    }
+}
 
-    auto result = EdgeMap();
-    for (const auto& m : future.get()) {
-        result.insert(m.begin(), m.end());
+
+// bands of rows are scanned side by side into plain edge lists, then linked in band order so the edges
+// still reach the linker row by row
+std::vector<Polygon> floodfill(const WallMask& mask, ThreadPool* pool) {
+    const auto width = mask.width;
+    const auto height = mask.height;
+    auto result = ContourLinker(width);
+    const auto emit = [&](Vector2i a, Vector2i b){ result.add(a, b); };
+    const auto block = pool ? band_rows(width, height, *pool) : height;
+    if (block >= height) {
+        flood_rows(mask, 0, height, emit);
+        return result.chains();
     }
 
-    // std::cout << "==============" << result.size() << "\n";
+    auto bands = pool->submit_sequence((usize)0, (height + block - 1) / block, [&](usize i){
+        auto edges = EdgeList();
+        flood_rows(mask, i * block, std::min((i + 1) * block, height),
+            [&](Vector2i a, Vector2i b){ edges.push_back({ a, b }); });
+        return edges;
+    }).get();
+    for (const auto& edges : bands) {
+        for (const auto& [a, b] : edges) { emit(a, b); }
+    }
 
-    return concat_edges(result);
+    return result.chains();
 }
 
 }
@@ -1,4 +1,5 @@
 #include "funnel.h"
+#include <algorithm>
 
 
 namespace nav {
@@ -8,7 +9,7 @@ Path edge_to_edge(const Mesh& mesh, std::vector<CrossInfo>&& path, Vector2f begi
         return { begin, end };
     }
 
-    auto result = std::vector<Vector2f>();
+    auto result = Path();
     result.push_back(begin);
     for (CrossInfo i : path) {
         if (i.neighbor_index != SIZE_MAX) {
@@ -20,154 +21,104 @@ Path edge_to_edge(const Mesh& mesh, std::vector<CrossInfo>&& path, Vector2f begi
 }
 
 
-struct FunnelVertex {
-    usize vertex_index;
-    usize list_index;
-    Vector2f pos;
-};
-
 // (lhs <-- rhs) forms positive (CCW) angle arc
 // (lhs --> rhs) forms negative (CW)  angle arc
 static bool pos_angle(Vector2f lhs, Vector2f rhs) {
     return rhs.perp_cw().dot(lhs) < 0;
 }
 
-Path funnel(const Mesh& mesh, std::vector<CrossInfo>&& path, Vector2f begin, Vector2f end) {
+// emit(pos, i) is called for every corner after begin, i being the corridor step the corner was found on
+template<typename F>
+static void funnel_impl(const Mesh& mesh, const std::vector<CrossInfo>& path, Vector2f begin, Vector2f end, f32 radius, PathScratch& scratch, F&& emit) {
     if (path.size() == 2 && path[0].next_index == path[1].next_index) {
-        return { begin, end };
+        emit(end, path.size() - 1);
+        return;
     }
 
-    auto list_l = std::vector<FunnelVertex>();
-    auto list_r = std::vector<FunnelVertex>();
+    auto& list_l = scratch.list_l;
+    auto& list_r = scratch.list_r;
+    list_l.clear();
+    list_r.clear();
     for (CrossInfo i : path) {
         if (i.neighbor_index != SIZE_MAX) {
-            const auto a = mesh.edges[i.next_index][i.neighbor_index].a;
-            const auto b = mesh.edges[i.next_index][i.neighbor_index].b;
-            list_l.push_back({ a, list_l.size(), mesh.vertices[a] });
-            list_r.push_back({ b, list_r.size(), mesh.vertices[b] });
+            const auto& e = mesh.edges[i.next_index][i.neighbor_index];
+            auto pos_a = mesh.vertices[e.a];
+            auto pos_b = mesh.vertices[e.b];
+            if (radius > 0.f) {
+                // pull both portal ends inwards so corners keep radius distance from walls
+                const auto shrink = (pos_b - pos_a) * portal_shrink(e, radius);
+                pos_a += shrink;
+                pos_b -= shrink;
+            }
+            list_l.push_back(pos_a);
+            list_r.push_back(pos_b);
         }
     }
-    list_l.push_back({ SIZE_MAX, list_l.size(), end });
-    list_r.push_back({ SIZE_MAX, list_r.size(), end });
+    list_l.push_back(end);
+    list_r.push_back(end);
 
-    auto result = std::vector<Vector2f>{ begin };
     auto root = begin;
-    auto arm_l = list_l.front();
-    auto arm_r = list_r.front();
+    usize arm_l = 0;
+    usize arm_r = 0;
     usize idx_l = 0;
     usize idx_r = 0;
 
     while (true) {
         if (++idx_l == list_l.size()) {
-            result.push_back(end);
-            return result;
+            emit(end, list_l.size() - 1);
+            return;
         } else {
-            const auto pos_new = list_l[idx_l].pos;
-            const auto pos_old = arm_l.pos;
+            const auto pos_new = list_l[idx_l];
+            const auto pos_old = list_l[arm_l];
             if (!pos_angle(pos_old - root, pos_new - root)) {
-                const auto pos_right = arm_r.pos;
+                const auto pos_right = list_r[arm_r];
                 if (pos_angle(pos_new - root, pos_right - root)) {
                     root = pos_right;
-                    result.push_back(root);
-                    idx_r = arm_r.list_index + 1;
-                    arm_r = list_r[idx_r];
+                    emit(root, arm_r);
+                    idx_r = arm_r + 1;
+                    arm_r = idx_r;
                     idx_l = idx_r;
                 }
-                arm_l = list_l[idx_l];
+                arm_l = idx_l;
             }
         }
 
         if (++idx_r == list_r.size()) {
-            result.push_back(end);
-            return result;
+            emit(end, list_r.size() - 1);
+            return;
         } else {
-            const auto pos_new = list_r[idx_r].pos;
-            const auto pos_old = arm_r.pos;
+            const auto pos_new = list_r[idx_r];
+            const auto pos_old = list_r[arm_r];
             if (!pos_angle(pos_new - root, pos_old - root)) {
-                const auto pos_left = arm_l.pos;
+                const auto pos_left = list_l[arm_l];
                 if (pos_angle(pos_left - root, pos_new - root)) {
                     root = pos_left;
-                    result.push_back(root);
-                    idx_l = arm_l.list_index + 1;
-                    arm_l = list_l[idx_l];
+                    emit(root, arm_l);
+                    idx_l = arm_l + 1;
+                    arm_l = idx_l;
                     idx_r = idx_l;
                 }
-                arm_r = list_r[idx_r];
+                arm_r = idx_r;
             }
         }
     }
-
-    return {};
 }
 
-/*
-IndexedPath funnel_indexed(const Mesh& mesh, std::vector<CrossInfo>&& path, IndexedPoint begin, IndexedPoint end) {
-    if (path.size() == 2 && path[0].next_index == path[1].next_index) {
-        return { begin, end };
-    }
-
-    auto list_l = std::vector<FunnelVertex>();
-    auto list_r = std::vector<FunnelVertex>();
-    for (CrossInfo i : path) {
-        if (i.neighbor_index != SIZE_MAX) {
-            const auto a = mesh.edges[i.next_index][i.neighbor_index].a;
-            const auto b = mesh.edges[i.next_index][i.neighbor_index].b;
-            list_l.push_back({ a, list_l.size(), mesh.vertices[a] });
-            list_r.push_back({ b, list_r.size(), mesh.vertices[b] });
-        }
-    }
-    list_l.push_back({ SIZE_MAX, list_l.size(), end });
-    list_r.push_back({ SIZE_MAX, list_r.size(), end });
-
-    auto result = std::vector<Vector2f>{ begin };
-    auto root = begin;
-    auto arm_l = list_l.front();
-    auto arm_r = list_r.front();
-    usize idx_l = 0;
-    usize idx_r = 0;
-
-    while (true) {
-        if (++idx_l == list_l.size()) {
-            result.push_back(end);
-            return result;
-        } else {
-            const auto pos_new = list_l[idx_l].pos;
-            const auto pos_old = arm_l.pos;
-            if (!pos_angle(pos_old - root, pos_new - root)) {
-                const auto pos_right = arm_r.pos;
-                if (pos_angle(pos_new - root, pos_right - root)) {
-                    root = pos_right;
-                    result.push_back(root);
-                    idx_r = arm_r.list_index+1;
-                    arm_r = list_r[idx_r];
-                    idx_l = idx_r;
-                }
-                arm_l = list_l[idx_l];
-            }
-        }
-
-        if (++idx_r == list_r.size()) {
-            result.push_back(end);
-            return result;
-        } else {
-            const auto pos_new = list_r[idx_r].pos;
-            const auto pos_old = arm_r.pos;
-            if (!pos_angle(pos_new - root, pos_old - root)) {
-                const auto pos_left = arm_l.pos;
-                if (pos_angle(pos_left - root, pos_new - root)) {
-                    root = pos_left;
-                    result.push_back(root);
-                    idx_l = arm_l.list_index+1;
-                    arm_l = list_l[idx_l];
-                    idx_r = idx_l;
-                }
-                arm_r = list_r[idx_r];
-            }
-        }
-    }
+void funnel(const Mesh& mesh, const std::vector<CrossInfo>& path, Vector2f begin, Vector2f end, f32 radius, PathScratch& scratch, Path& result) {
+    result.clear();
+    result.push_back(begin);
+    funnel_impl(mesh, path, begin, end, radius, scratch, [&](Vector2f pos, usize){
+        result.push_back(pos);
+    });
+}
 
-    return {};
+// a corner lies on the portal out of path[i], it is attributed to the triangle entered through it
+void funnel_indexed(const Mesh& mesh, const std::vector<CrossInfo>& path, Vector2f begin, Vector2f end, f32 radius, PathScratch& scratch, IndexedPath& result) {
+    result.clear();
+    result.push_back(IndexedPoint{ begin, path.front().next_index });
+    funnel_impl(mesh, path, begin, end, radius, scratch, [&](Vector2f pos, usize i){
+        result.push_back(IndexedPoint{ pos, path[std::min(i + 1, path.size() - 1)].next_index });
+    });
 }
-*/
 
 }
@@ -1,17 +1,18 @@
 #pragma once
 #include "mesh.h"
+#include <algorithm>
 
 
 namespace nav {
 
-struct CrossInfo {
-    size_t next_index;
-    size_t neighbor_index;
-};
-
+// how far along a portal its ends are pulled in for an agent of radius, as a share of its width. never past the
+// middle, and zero for a portal of no width, so narrow and degenerate portals collapse to a point
+inline f32 portal_shrink(const Mesh::Edge& e, f32 radius) {
+    return e.width > 0.f ? std::min(radius / e.width, 0.5f) : 0.f;
+}
 
 Path edge_to_edge(const Mesh& mesh, std::vector<CrossInfo>&& path, Vector2f begin, Vector2f end);
-Path funnel(const Mesh& mesh, std::vector<CrossInfo>&& path, Vector2f begin, Vector2f end);
-// IndexedPath funnel_indexed(const Mesh& mesh, std::vector<CrossInfo>&& path, IndexedPoint begin, IndexedPoint end);
+void funnel(const Mesh& mesh, const std::vector<CrossInfo>& path, Vector2f begin, Vector2f end, f32 radius, PathScratch& scratch, Path& result);
+void funnel_indexed(const Mesh& mesh, const std::vector<CrossInfo>& path, Vector2f begin, Vector2f end, f32 radius, PathScratch& scratch, IndexedPath& result);
 
 }
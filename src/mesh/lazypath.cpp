@@ -0,0 +1,129 @@
+#include "path.h"
+#include "funnel.h"
+
+
+namespace nav {
+
+// (lhs <-- rhs) forms positive (CCW) angle arc
+// (lhs --> rhs) forms negative (CW)  angle arc
+static bool pos_angle(Vector2f lhs, Vector2f rhs) {
+    return rhs.perp_cw().dot(lhs) < 0;
+}
+
+
+void LazyPath::assign(const Mesh* mesh, const std::vector<CrossInfo>& corridor, Vector2f begin, Vector2f end, f32 radius) {
+    p_mesh = mesh;
+    m_corridor.assign(corridor.begin(), corridor.end());
+    m_root = begin;
+    m_end = end;
+    m_radius = radius;
+    m_apex = 0;
+    m_resume_r = false;
+    m_done = m_corridor.empty();
+}
+
+void LazyPath::clear() {
+    m_corridor.clear();
+    m_apex = 0;
+    m_resume_r = false;
+    m_done = true;
+}
+
+
+bool LazyPath::is_done() const {
+    return m_done;
+}
+
+Vector2f LazyPath::get_end() const {
+    return m_end;
+}
+
+const std::vector<CrossInfo>& LazyPath::get_corridor() const {
+    return m_corridor;
+}
+
+
+// portal i is the edge crossed out of corridor[i], the one past the last portal is the end point
+Vector2f LazyPath::portal_l(usize i) const {
+    if (i + 1 == m_corridor.size()) { return m_end; }
+    const auto& e = p_mesh->edges[m_corridor[i].next_index][m_corridor[i].neighbor_index];
+    if (m_radius > 0.f) {
+        return p_mesh->vertices[e.a] + (p_mesh->vertices[e.b] - p_mesh->vertices[e.a]) * portal_shrink(e, m_radius);
+    }
+    return p_mesh->vertices[e.a];
+}
+
+Vector2f LazyPath::portal_r(usize i) const {
+    if (i + 1 == m_corridor.size()) { return m_end; }
+    const auto& e = p_mesh->edges[m_corridor[i].next_index][m_corridor[i].neighbor_index];
+    if (m_radius > 0.f) {
+        return p_mesh->vertices[e.b] + (p_mesh->vertices[e.a] - p_mesh->vertices[e.b]) * portal_shrink(e, m_radius);
+    }
+    return p_mesh->vertices[e.b];
+}
+
+
+// same funnel as in funnel.cpp, but it stops at the first corner and remembers where to resume from.
+// a corner found on the left side resumes with the right side, exactly as the full funnel would
+Vector2f LazyPath::next() {
+    const auto count = m_corridor.size();
+    usize arm_l = m_apex;
+    usize arm_r = m_apex;
+    usize idx_l = m_apex;
+    usize idx_r = m_apex;
+    auto skip_l = m_resume_r;
+
+    while (true) {
+        if (skip_l) {
+            skip_l = false;
+        } else if (++idx_l >= count) {
+            m_done = true;
+            return m_end;
+        } else {
+            const auto pos_new = portal_l(idx_l);
+            const auto pos_old = portal_l(arm_l);
+            if (!pos_angle(pos_old - m_root, pos_new - m_root)) {
+                const auto pos_right = portal_r(arm_r);
+                if (pos_angle(pos_new - m_root, pos_right - m_root)) {
+                    m_root = pos_right;
+                    m_apex = arm_r + 1;
+                    m_resume_r = true;
+                    return m_root;
+                }
+                arm_l = idx_l;
+            }
+        }
+
+        if (++idx_r >= count) {
+            m_done = true;
+            return m_end;
+        } else {
+            const auto pos_new = portal_r(idx_r);
+            const auto pos_old = portal_r(arm_r);
+            if (!pos_angle(pos_new - m_root, pos_old - m_root)) {
+                const auto pos_left = portal_l(arm_l);
+                if (pos_angle(pos_left - m_root, pos_new - m_root)) {
+                    m_root = pos_left;
+                    m_apex = arm_l + 1;
+                    m_resume_r = false;
+                    return m_root;
+                }
+                arm_r = idx_r;
+            }
+        }
+    }
+}
+
+IndexedPoint LazyPath::next_indexed() {
+    const auto pos = next();
+    const auto i = m_done ? m_corridor.size() - 1 : m_apex;
+    return IndexedPoint{ pos, m_corridor[i].next_index };
+}
+
+void LazyPath::drain(Path& result) {
+    while (!m_done) {
+        result.push_back(next());
+    }
+}
+
+}
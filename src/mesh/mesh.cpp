@@ -1,4 +1,6 @@
 #include "mesh.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
 
@@ -27,12 +29,43 @@ std::optional<size_t> Mesh::get_triangle(Vector2f p, float error) const {
 }
 
 
+// the largest radius that fits through every portal of the triangle, so an agent with it can be anywhere between
+// them. a wide way in does not make up for a narrow pinch on the other side. a triangle without portals has none
+void Mesh::bake_clearance() {
+    for (usize i = 0; i < triangles.size(); i++) {
+        const auto& portals = edges[i];
+        auto clearance = portals.empty() ? 0.f : portals[0].width * 0.5f;
+        for (const auto& e : portals) {
+            clearance = std::min(clearance, e.width * 0.5f);
+        }
+        triangles[i].clearance = clearance;
+    }
+}
+
+
+// files start with the magic and a version. the first files had neither, they began with the triangle count and
+// stored edges without their width
+static constexpr u32 FILE_MAGIC = 0x4D56414E; // "NAVM"
+static constexpr u32 FILE_VERSION = 2;
+
+struct EdgeV1 {
+    usize index;
+    Vector2f center;
+    usize a;
+    usize b;
+};
+
+
 void Mesh::write_file(const std::filesystem::path& filename, float scale) const {
     auto f = std::ofstream(PATH_NORM(filename), std::ios::binary);
+    f.write((const char*)&FILE_MAGIC, sizeof(u32));
+    f.write((const char*)&FILE_VERSION, sizeof(u32));
     const auto tri_count = triangles.size();
     f.write((char*)&tri_count, sizeof(usize));
     for (const auto& tri : triangles) {
-        f.write((char*)&tri, sizeof(Triangle));
+        auto _tri = tri;
+        _tri.clearance /= scale;
+        f.write((char*)&_tri, sizeof(Triangle));
     }
     const auto vert_count = vertices.size();
     f.write((char*)&vert_count, sizeof(usize));
@@ -43,10 +76,10 @@ void Mesh::write_file(const std::filesystem::path& filename, float scale) const
     const auto edge_count = edges.size();
     f.write((char*)&edge_count, sizeof(usize));
     for (const auto& e : edges) {
-        const Edge neg = { SIZE_MAX, Vector2f{}, 0, 0 };
+        const Edge neg = { SIZE_MAX, Vector2f{}, 0, 0, 0.f };
         for (size_t i = 0; i < 3; i++) {
             if (e.size() > i) {
-                const auto _e = Mesh::Edge{ e[i].index, e[i].center / scale, e[i].a, e[i].b };
+                const auto _e = Mesh::Edge{ e[i].index, e[i].center / scale, e[i].a, e[i].b, e[i].width / scale };
                 f.write((char*)&_e, sizeof(Edge));
             } else {
                 f.write((char*)&neg, sizeof(Edge));
@@ -59,12 +92,23 @@ void Mesh::write_file(const std::filesystem::path& filename, float scale) const
 Mesh Mesh::read_file(const std::filesystem::path& filename, float scale) {
     auto f = std::ifstream(PATH_NORM(filename), std::ios::binary);
     auto result = Mesh();
+    u32 header[2] = { 0, 0 };
+    f.read((char*)header, sizeof(header));
+    auto version = (u32)1;
     usize tri_count = 0;
-    f.read((char*)&tri_count, sizeof(usize));
+    if (header[0] == FILE_MAGIC) {
+        version = header[1];
+        if (version != FILE_VERSION) { return result; }
+        f.read((char*)&tri_count, sizeof(usize));
+    } else {
+        std::memcpy(&tri_count, header, sizeof(usize));
+    }
+
     result.triangles.reserve(tri_count);
     for (usize i = 0; i < tri_count; i++) {
         auto tri = Triangle();
         f.read((char*)&tri, sizeof(Triangle));
+        tri.clearance *= scale;
         result.triangles.push_back(tri);
     }
     usize vert_count = 0;
@@ -81,12 +125,31 @@ Mesh Mesh::read_file(const std::filesystem::path& filename, float scale) {
     result.edges.reserve(edge_count);
     for (usize i = 0; i < edge_count; i++) {
         auto& edge = result.edges.emplace_back();
-        Edge e;
         for (usize j = 0; j < 3; j++) {
-            f.read((char*)&e, sizeof(Edge));
+            auto e = Edge();
+            if (version == 1) {
+                auto old = EdgeV1();
+                f.read((char*)&old, sizeof(EdgeV1));
+                e = Edge{ old.index, old.center, old.a, old.b, 0.f };
+            } else {
+                f.read((char*)&e, sizeof(Edge));
+            }
+            if (e.index == SIZE_MAX) { continue; }
             e.center *= scale;
-            if (e.index != SIZE_MAX) { edge.push_back(e); }
+            e.width *= scale;
+            edge.push_back(e);
+        }
+    }
+    if (!f) { return Mesh(); }
+
+    // widths and clearance were not stored yet, they follow from the vertices
+    if (version == 1) {
+        for (auto& portals : result.edges) {
+            for (auto& e : portals) {
+                if (e.a < vert_count && e.b < vert_count) { e.width = (result.vertices[e.b] - result.vertices[e.a]).length(); }
+            }
         }
+        result.bake_clearance();
     }
     return result;
 }
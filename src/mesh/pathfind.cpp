@@ -1,6 +1,5 @@
 #include "lib.h"
-#include <queue>
-#include <unordered_map>
+#include <algorithm>
 #include "funnel.h"
 
 
@@ -11,174 +10,139 @@ static float Chebyshev(Vector2f a, Vector2f b) { const auto d = Vector2f(b-a); r
 const auto H = Chebyshev;
 
 
-struct AStarTuple {
-    size_t id;
-    size_t parent;
-    Vector2f pos;
-    float g_cost = std::numeric_limits<float>::infinity();
-    float f_cost = std::numeric_limits<float>::infinity();
-};
-bool operator< (const AStarTuple& a, const AStarTuple& b) { return a.f_cost <  b.f_cost; }
-bool operator> (const AStarTuple& a, const AStarTuple& b) { return a.f_cost >  b.f_cost; }
-bool operator<=(const AStarTuple& a, const AStarTuple& b) { return a.f_cost <= b.f_cost; }
-bool operator>=(const AStarTuple& a, const AStarTuple& b) { return a.f_cost >= b.f_cost; }
-bool operator==(const AStarTuple& a, const AStarTuple& b) { return a.id == b.id && a.parent == b.parent && a.g_cost == b.g_cost && a.f_cost == b.f_cost; }
-bool operator!=(const AStarTuple& a, const AStarTuple& b) { return !(a == b); }
-
-template<typename T>
-using LowPrioQueue = std::priority_queue<T, std::vector<T>, std::greater<T>>;
-template<typename T>
-using HighPrioQueue = std::priority_queue<T, std::vector<T>, std::less<T>>;
-
-
-// finds i such that B is the ith neighbor of A
-static size_t get_neighbor_index(const Mesh& mesh, size_t a, size_t b) {
-    const auto& edges = mesh.edges[a];
-    size_t i = 0;
-    for (const auto& e : edges) {
-        if (e.index == b) {
-            return i;
-        }
-        i++;
+using OpenEntry = std::pair<f32, usize>;
+static bool open_cmp(const OpenEntry& a, const OpenEntry& b) { return a.first > b.first; }
+
+// invalidates all per-triangle state in O(1) by bumping the generation
+static void begin_search(PathScratch& scratch, usize count) {
+    if (scratch.visited.size() < count) {
+        scratch.g_cost.resize(count);
+        scratch.f_cost.resize(count);
+        scratch.parent.resize(count);
+        scratch.via.resize(count);
+        scratch.entry.resize(count);
+        scratch.visited.resize(count, 0);
     }
-    return SIZE_MAX;
+    if (++scratch.generation == 0) {
+        std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+        scratch.generation = 1;
+    }
+    scratch.open.clear();
 }
 
-Path Mesh::pathfind(Vector2f begin, Vector2f end) const {
+static void visit(PathScratch& s, usize id, usize parent, usize via, Vector2f entry, f32 g_cost, f32 f_cost) {
+    s.visited[id] = s.generation;
+    s.parent[id] = parent;
+    s.via[id] = via;
+    s.entry[id] = entry;
+    s.g_cost[id] = g_cost;
+    s.f_cost[id] = f_cost;
+}
+
+
+bool Mesh::find_corridor(Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius) const {
+    scratch.corridor.clear();
+    scratch.expanded = 0;
     const auto begin_idx = get_triangle(begin, 0.05f);
-    const auto end_idx = get_triangle(end, 0.f);
-    if (!begin_idx.has_value()) { return {}; }
-    if (!end_idx.has_value()) { return {}; }
-    if (begin_idx == end_idx) { return { begin, end }; }
-
-    auto queue = LowPrioQueue<AStarTuple>();
-    queue.push(AStarTuple{ *begin_idx, *begin_idx, begin, 0, H(begin, end) });
-
-    auto lut = std::unordered_map<size_t, AStarTuple>();
-    lut[*begin_idx] = AStarTuple{ *begin_idx, *begin_idx, begin, 0, H(begin, end) };
-
-    while (!queue.empty()) {
-        const auto current = queue.top();
-        queue.pop();
-
-        if (current.id == *end_idx) {
-            if (lut.find(*end_idx) != lut.end()) {
-                auto cur = *end_idx;
-                auto cur_pos = end;
-                auto total_path = std::vector<CrossInfo>{ CrossInfo{ cur, SIZE_MAX } };
-                auto it = lut.find(cur);
-                while (it != lut.end() && (it->second.parent != cur)) {
-                    const auto n = get_neighbor_index(*this, it->second.parent, cur);
-                    cur = it->second.parent;
-                    cur_pos = lut.at(cur).pos;
-                    total_path.insert(total_path.begin(), CrossInfo{ cur, n });
-                    it = lut.find(cur);
-                }
-                // return edge_to_edge(*this, std::move(total_path), begin, end);
-                return funnel(*this, std::move(total_path), begin, end);
-            } else {
-                return {};
+    if (!begin_idx.has_value()) { return false; }
+    return find_corridor(*begin_idx, begin, end, scratch, radius);
+}
+
+bool Mesh::find_corridor(usize begin_tri, Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius) const {
+    scratch.corridor.clear();
+    scratch.expanded = 0;
+    const auto end_idx = triangles[begin_tri].contains(vertices.data(), end) ? begin_tri : get_triangle(end, 0.f);
+    if (!end_idx.has_value()) { return false; }
+    return find_corridor(begin_tri, *end_idx, begin, end, scratch, radius);
+}
+
+bool Mesh::find_corridor(usize begin_tri, usize end_tri, Vector2f begin, Vector2f end, PathScratch& scratch, f32 radius) const {
+    scratch.corridor.clear();
+    scratch.expanded = 0;
+    const auto begin_idx = std::optional<size_t>(begin_tri);
+    const auto end_idx = std::optional<size_t>(end_tri);
+    if (begin_idx == end_idx) { scratch.corridor.push_back(CrossInfo{ *begin_idx, SIZE_MAX }); return true; }
+
+    begin_search(scratch, triangles.size());
+    visit(scratch, *begin_idx, *begin_idx, SIZE_MAX, begin, 0, H(begin, end));
+    scratch.open.push_back({ H(begin, end), *begin_idx });
+
+    while (!scratch.open.empty()) {
+        std::pop_heap(scratch.open.begin(), scratch.open.end(), open_cmp);
+        const auto [f_cost, current] = scratch.open.back();
+        scratch.open.pop_back();
+        if (f_cost > scratch.f_cost[current]) { continue; }
+        scratch.expanded++;
+
+        if (current == *end_idx) {
+            // walk the parents back from the goal, then flip into begin -> end order
+            auto& corridor = scratch.corridor;
+            corridor.push_back(CrossInfo{ current, SIZE_MAX });
+            auto cur = current;
+            while (scratch.parent[cur] != cur) {
+                corridor.push_back(CrossInfo{ scratch.parent[cur], scratch.via[cur] });
+                cur = scratch.parent[cur];
             }
+            std::reverse(corridor.begin(), corridor.end());
+            return true;
         }
 
-        const auto c_g_cost = lut[current.id].g_cost;
-        for (size_t i = 0; i < edges[current.id].size(); i++) {
-            const auto n_id = edges[current.id][i].index;
-            const auto dist = Euclidean(lut[current.id].pos, edges[current.id][i].center);
-            const auto g_cost_tentative = c_g_cost + dist * triangles[edges[current.id][i].index].weight;
-            if (lut.find(n_id) == lut.end()) {
-                lut[n_id] = AStarTuple{
-                    n_id,
-                    n_id,
-                    edges[current.id][i].center,
-                    std::numeric_limits<float>::infinity(),
-                    std::numeric_limits<float>::infinity(),
-                };
-            }
-            const auto g_cost_neighbor = lut[n_id].g_cost;
-            if (g_cost_tentative < g_cost_neighbor) {
-                lut[n_id] = AStarTuple{
-                    n_id,
-                    current.id,
-                    edges[current.id][i].center,
-                    g_cost_tentative,
-                    g_cost_tentative + H(edges[current.id][i].center, end),
-                };
-                queue.push(lut[n_id]);
+        const auto c_g_cost = scratch.g_cost[current];
+        const auto c_pos = scratch.entry[current];
+        for (size_t i = 0; i < edges[current].size(); i++) {
+            const auto& e = edges[current][i];
+            if (e.width < 2.f * radius) { continue; }
+            const auto n_id = e.index;
+            const auto g_cost_tentative = c_g_cost + Euclidean(c_pos, e.center) * triangles[n_id].weight;
+            if (scratch.visited[n_id] != scratch.generation || g_cost_tentative < scratch.g_cost[n_id]) {
+                const auto f_cost_tentative = g_cost_tentative + H(e.center, end);
+                visit(scratch, n_id, current, i, e.center, g_cost_tentative, f_cost_tentative);
+                scratch.open.push_back({ f_cost_tentative, n_id });
+                std::push_heap(scratch.open.begin(), scratch.open.end(), open_cmp);
             }
         }
     }
 
-    return {};
+    return false;
 }
 
-/*
-IndexedPath Mesh::pathfind_indexed(Vector2f begin, Vector2f end) const {
-    const auto begin_idx = get_triangle(begin, 0.05f);
-    const auto end_idx = get_triangle(end, 0.f);
-    if (!begin_idx.has_value()) { return {}; }
-    if (!end_idx.has_value()) { return {}; }
-    if (begin_idx == end_idx) { return { IndexedPoint{ begin, *begin_idx }, IndexedPoint{ end, *end_idx } }; }
-
-    auto queue = LowPrioQueue<AStarTuple>();
-    queue.push(AStarTuple{ *begin_idx, *begin_idx, begin, 0, H(begin, end) });
-
-    auto lut = std::unordered_map<size_t, AStarTuple>();
-    lut[*begin_idx] = AStarTuple{ *begin_idx, *begin_idx, begin, 0, H(begin, end) };
-
-    while (!queue.empty()) {
-        const auto current = queue.top();
-        queue.pop();
-
-        if (current.id == *end_idx) {
-            if (lut.find(*end_idx) != lut.end()) {
-                auto cur = *end_idx;
-                auto cur_pos = end;
-                auto total_path = std::vector<CrossInfo>{ CrossInfo{ cur, SIZE_MAX } };
-                auto it = lut.find(cur);
-                while (it != lut.end() && (it->second.parent != cur)) {
-                    const auto n = get_neighbor_index(*this, it->second.parent, cur);
-                    cur = it->second.parent;
-                    cur_pos = lut.at(cur).pos;
-                    total_path.insert(total_path.begin(), CrossInfo{ cur, n });
-                    it = lut.find(cur);
-                }
-                return funnel_indexed(*this, std::move(total_path), IndexedPoint{ begin, *begin_idx }, IndexedPoint{ end, *end_idx } });
-            } else {
-                return {};
-            }
-        }
+bool Mesh::pathfind(Vector2f begin, Vector2f end, Path& result, PathScratch& scratch, f32 radius) const {
+    result.clear();
+    if (!find_corridor(begin, end, scratch, radius)) { return false; }
+    if (scratch.corridor.size() == 1) { result.push_back(begin); result.push_back(end); return true; }
+    funnel(*this, scratch.corridor, begin, end, radius, scratch, result);
+    return true;
+}
 
-        const auto c_g_cost = lut[current.id].g_cost;
-        for (size_t i = 0; i < edges[current.id].size(); i++) {
-            const auto n_id = edges[current.id][i].index;
-            const auto dist = Euclidean(lut[current.id].pos, edges[current.id][i].center);
-            const auto g_cost_tentative = c_g_cost + dist * triangles[edges[current.id][i].index].weight;
-            if (lut.find(n_id) == lut.end()) {
-                lut[n_id] = AStarTuple{
-                    n_id,
-                    n_id,
-                    edges[current.id][i].center,
-                    std::numeric_limits<float>::infinity(),
-                    std::numeric_limits<float>::infinity(),
-                };
-            }
-            const auto g_cost_neighbor = lut[n_id].g_cost;
-            if (g_cost_tentative < g_cost_neighbor) {
-                lut[n_id] = AStarTuple{
-                    n_id,
-                    current.id,
-                    edges[current.id][i].center,
-                    g_cost_tentative,
-                    g_cost_tentative + H(edges[current.id][i].center, end),
-                };
-                queue.push(lut[n_id]);
-            }
-        }
-    }
+Path Mesh::pathfind(Vector2f begin, Vector2f end, f32 radius) const {
+    auto result = Path();
+    pathfind(begin, end, result, PathScratch::local(), radius);
+    return result;
+}
 
-    return {};
+
+PathScratch& PathScratch::local() {
+    thread_local auto scratch = PathScratch();
+    return scratch;
+}
+
+IndexedPath Mesh::pathfind_indexed(Vector2f begin, Vector2f end, f32 radius) const {
+    auto result = IndexedPath();
+    pathfind_indexed(begin, end, result, PathScratch::local(), radius);
+    return result;
+}
+
+bool Mesh::pathfind_indexed(Vector2f begin, Vector2f end, IndexedPath& result, PathScratch& scratch, f32 radius) const {
+    result.clear();
+    if (!find_corridor(begin, end, scratch, radius)) { return false; }
+    if (scratch.corridor.size() == 1) {
+        const auto tri = scratch.corridor.front().next_index;
+        result.push_back(IndexedPoint{ begin, tri });
+        result.push_back(IndexedPoint{ end, tri });
+        return true;
+    }
+    funnel_indexed(*this, scratch.corridor, begin, end, radius, scratch, result);
+    return true;
 }
-*/
 
 }
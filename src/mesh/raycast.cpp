@@ -0,0 +1,237 @@
+#include "mesh.h"
+#include <BS_thread_pool.hpp>
+#include <algorithm>
+#include <numeric>
+
+
+namespace nav {
+
+// orientation of c against the line a -> b. differences and products of floats are exact in doubles, so the sign
+// is right even for rays that graze a corner, and a side gives the same value from both of its triangles
+static f64 side(Vector2f a, Vector2f b, Vector2f c) {
+    return ((f64)a.x - c.x) * ((f64)b.y - c.y) - ((f64)b.x - c.x) * ((f64)a.y - c.y);
+}
+
+static bool opposite(f64 a, f64 b) {
+    return (a > 0.0 && b < 0.0) || (a < 0.0 && b > 0.0);
+}
+
+
+// true if the ray from p, a point on the outline of tri, goes into tri: end is not beyond any side p lies on
+static bool enters(const Mesh& mesh, usize tri, Vector2f p, Vector2f end) {
+    const auto& t = mesh.triangles[tri];
+    const usize corners[3] = { t.A, t.B, t.C };
+    for (usize k = 0; k < 3; k++) {
+        const auto a = mesh.vertices[corners[k]];
+        const auto b = mesh.vertices[corners[(k + 1) % 3]];
+        const auto c = mesh.vertices[corners[(k + 2) % 3]];
+        if (side(a, b, p) == 0.0 && opposite(side(a, b, end), side(a, b, c))) { return false; }
+    }
+    return true;
+}
+
+// turns through the triangles around corner w, starting from tri, until one that the ray from w goes into.
+// both ways round are tried since w may be on a wall, cross(tri, edge) is called for the portals of the way found
+template<typename F>
+static usize around(const Mesh& mesh, usize tri, usize w, Vector2f end, F&& cross) {
+    const auto at = mesh.vertices[w];
+    const auto& t = mesh.triangles[tri];
+    const usize corners[3] = { t.A, t.B, t.C };
+    auto steps = SmallVec<CrossInfo, 16>();
+
+    for (const auto k : corners) {
+        if (k == w) { continue; }
+        steps.clear();
+        auto cur = tri;
+        auto spoke = k;
+        while (steps.size() < mesh.triangles.size()) {
+            const auto& edges = mesh.edges[cur];
+            auto i = (usize)0;
+            while (i < edges.size() && !((edges[i].a == w && edges[i].b == spoke) || (edges[i].a == spoke && edges[i].b == w))) { i++; }
+            if (i == edges.size() || edges[i].index == tri) { break; }
+            steps.push_back(CrossInfo{ cur, i });
+            cur = edges[i].index;
+            if (enters(mesh, cur, at, end)) {
+                for (const auto& s : steps) { cross(s.next_index, s.neighbor_index); }
+                return cur;
+            }
+            const auto& n = mesh.triangles[cur];
+            spoke = n.A != w && n.A != spoke ? n.A : n.B != w && n.B != spoke ? n.B : n.C;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// a start on a corner or side of begin_tri is on the triangles next to it as well, the walk has to start in the one
+// the ray actually goes into
+static usize entered_triangle(const Mesh& mesh, usize begin_tri, Vector2f begin, Vector2f end) {
+    if (enters(mesh, begin_tri, begin, end)) { return begin_tri; }
+    const auto& t = mesh.triangles[begin_tri];
+    for (const auto k : { t.A, t.B, t.C }) {
+        if (mesh.vertices[k] == begin) {
+            const auto tri = around(mesh, begin_tri, k, end, [](usize, usize){});
+            return tri != SIZE_MAX ? tri : begin_tri;
+        }
+    }
+    for (const auto& e : mesh.edges[begin_tri]) {
+        if (side(mesh.vertices[e.a], mesh.vertices[e.b], begin) == 0.0 && enters(mesh, e.index, begin, end)) { return e.index; }
+    }
+    return begin_tri;
+}
+
+
+bool Mesh::raycast(Vector2f begin, Vector2f end) const {
+    const auto begin_idx = get_triangle(begin, 0.05f);
+    if (!begin_idx.has_value()) { return false; }
+    return raycast(*begin_idx, begin, end);
+}
+
+bool Mesh::raycast(usize begin_tri, Vector2f begin, Vector2f end) const {
+    return trace(begin_tri, begin, end).has_value();
+}
+
+// walks the triangle strip along the segment. a triangle is left through the side end lies beyond that the segment
+// passes strictly through, or where it leaves through a corner, into the triangle around that corner it goes on in.
+// cross(tri, edge) is called for every portal taken
+template<typename F>
+static std::optional<size_t> walk(const Mesh& mesh, usize begin_tri, Vector2f begin, Vector2f end, F&& cross) {
+    auto cur = entered_triangle(mesh, begin_tri, begin, end);
+    auto prev = SIZE_MAX;
+    // corners closer to the line than float rounding of the points are on it, so rays between funnel corners
+    // that graze a third one are not cut by the last bit
+    const auto dir = end - begin;
+    const auto reach = std::max({ std::abs(begin.x), std::abs(begin.y), std::abs(end.x), std::abs(end.y), 1.f });
+    const auto tolerance = 1e-6 * (f64)reach * std::sqrt((f64)dir.x * dir.x + (f64)dir.y * dir.y);
+    const auto snap = [=](f64 s) { return std::abs(s) <= tolerance ? 0.0 : s; };
+
+    for (usize steps = 0; steps < mesh.triangles.size(); steps++) {
+        const auto& t = mesh.triangles[cur];
+        const usize corners[3] = { t.A, t.B, t.C };
+        auto inside = true;
+        auto exit = SIZE_MAX;
+        auto corner = SIZE_MAX;
+        for (usize k = 0; k < 3; k++) {
+            const auto a = mesh.vertices[corners[k]];
+            const auto b = mesh.vertices[corners[(k + 1) % 3]];
+            if (!opposite(side(a, b, end), side(a, b, mesh.vertices[corners[(k + 2) % 3]]))) { continue; }
+            inside = false;
+            const auto sa = snap(side(begin, end, a));
+            const auto sb = snap(side(begin, end, b));
+            if (opposite(sa, sb)) {
+                exit = k;
+            } else if (sa == 0.0 && sb == 0.0) {
+                corner = (b - a).dot(dir) > 0.f ? corners[(k + 1) % 3] : corners[k];
+            } else if (sa == 0.0) {
+                corner = corners[k];
+            } else if (sb == 0.0) {
+                corner = corners[(k + 1) % 3];
+            }
+        }
+        if (inside) { return cur; }
+
+        auto next = SIZE_MAX;
+        if (exit != SIZE_MAX) {
+            const auto ia = corners[exit];
+            const auto ib = corners[(exit + 1) % 3];
+            const auto& edges = mesh.edges[cur];
+            for (usize i = 0; i < edges.size(); i++) {
+                const auto& e = edges[i];
+                if (e.index == prev || !((e.a == ia && e.b == ib) || (e.a == ib && e.b == ia))) { continue; }
+                cross(cur, i);
+                next = e.index;
+                break;
+            }
+        } else if (corner != SIZE_MAX) {
+            next = around(mesh, cur, corner, end, cross);
+        }
+        if (next == SIZE_MAX) { return {}; }
+        prev = cur;
+        cur = next;
+    }
+
+    return {};
+}
+
+std::optional<size_t> Mesh::trace(usize begin_tri, Vector2f begin, Vector2f end) const {
+    return walk(*this, begin_tri, begin, end, [](usize, usize){});
+}
+
+bool Mesh::trace(usize begin_tri, Vector2f begin, Vector2f end, std::vector<CrossInfo>& visited) const {
+    visited.clear();
+    const auto last = walk(*this, begin_tri, begin, end, [&](usize tri, usize edge){
+        visited.push_back(CrossInfo{ tri, edge });
+    });
+    if (!last.has_value()) { return false; }
+    visited.push_back(CrossInfo{ *last, SIZE_MAX });
+    return true;
+}
+
+
+// sorts queries by start point so every distinct start is located once. this is a scan of the whole mesh per start,
+// callers that already know their triangles pass them in instead
+template<typename F>
+static void locate_starts(const Mesh& mesh, const Vector2f* begins, usize count, std::vector<usize>& starts, F&& for_blocks) {
+    auto order = std::vector<usize>(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [=](usize a, usize b){
+        return begins[a].x < begins[b].x || (begins[a].x == begins[b].x && begins[a].y < begins[b].y);
+    });
+
+    auto runs = std::vector<usize>();
+    for (usize i = 0; i < count; i++) {
+        if (i == 0 || begins[order[i]] != begins[order[i-1]]) { runs.push_back(i); }
+    }
+    runs.push_back(count);
+
+    starts.resize(count);
+    for_blocks(runs.size() - 1, [&](usize lo, usize hi){
+        for (usize r = lo; r < hi; r++) {
+            const auto tri = mesh.get_triangle(begins[order[runs[r]]], 0.05f).value_or(SIZE_MAX);
+            for (usize i = runs[r]; i < runs[r+1]; i++) { starts[order[i]] = tri; }
+        }
+    });
+}
+
+// queries grouped by start triangle, so the walks from one triangle run back to back
+template<typename F>
+static void raycast_batch_impl(const Mesh& mesh, const usize* starts, const Vector2f* begins, const Vector2f* ends, usize count, u8* results, F&& for_blocks) {
+    auto order = std::vector<usize>(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](usize a, usize b){ return starts[a] < starts[b]; });
+
+    for_blocks(count, [&](usize lo, usize hi){
+        for (usize i = lo; i < hi; i++) {
+            const auto q = order[i];
+            results[q] = starts[q] < mesh.triangles.size() && mesh.raycast(starts[q], begins[q], ends[q]);
+        }
+    });
+}
+
+
+void Mesh::raycast_batch(const Vector2f* begins, const Vector2f* ends, usize count, u8* results) const {
+    const auto serial = [](usize n, auto&& block){ block(0, n); };
+    auto starts = std::vector<usize>();
+    locate_starts(*this, begins, count, starts, serial);
+    raycast_batch_impl(*this, starts.data(), begins, ends, count, results, serial);
+}
+
+void Mesh::raycast_batch(const Vector2f* begins, const Vector2f* ends, usize count, u8* results, ThreadPool& pool) const {
+    const auto pooled = [&](usize n, auto&& block){ pool.submit_blocks((usize)0, n, block).wait(); };
+    auto starts = std::vector<usize>();
+    locate_starts(*this, begins, count, starts, pooled);
+    raycast_batch_impl(*this, starts.data(), begins, ends, count, results, pooled);
+}
+
+void Mesh::raycast_batch(const usize* begin_tris, const Vector2f* begins, const Vector2f* ends, usize count, u8* results) const {
+    raycast_batch_impl(*this, begin_tris, begins, ends, count, results, [](usize n, auto&& block){
+        block(0, n);
+    });
+}
+
+void Mesh::raycast_batch(const usize* begin_tris, const Vector2f* begins, const Vector2f* ends, usize count, u8* results, ThreadPool& pool) const {
+    raycast_batch_impl(*this, begin_tris, begins, ends, count, results, [&](usize n, auto&& block){
+        pool.submit_blocks((usize)0, n, block).wait();
+    });
+}
+
+}
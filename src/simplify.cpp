@@ -1,94 +1,96 @@
 #include "lib.h"
 #include <cmath>
+#include <type_traits>
 #include "slice.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
 
 
 namespace nav {
 
+// integer points are measured in doubles, which hold their products exactly, float points in floats
 template<typename T>
-static f32 perp_dist(Vector2<T> l0, Vector2<T> l1, Vector2<T> p) {
-    const T num = (l1.y - l0.y) * p.x - (l1.x - l0.x) * p.y + l1.x * l0.y - l1.y * l0.x;
-    const T den = (l1.y - l0.y) * (l1.y - l0.y) + (l1.x - l0.x) * (l1.x - l0.x);
-    return std::abs((f32)num) / std::sqrt((f32)den);
-}
-
-template<typename T>
-static f32 euclid_dist(Vector2<T> p0, Vector2<T> p1) {
-    return std::sqrt((f32)((p0.x - p1.x) * (p0.x - p1.x) + (p0.y - p1.y) * (p0.y - p1.y)));
-}
+using Scalar = std::conditional_t<std::is_integral_v<T>, f64, f32>;
 
+static bool same_end(Vector2i a, Vector2i b) { return a == b; }
+static bool same_end(Vector2f a, Vector2f b) { return a.cmp(b) < 0.001f; }
 
-static void douglas_peucker_impl(Slice<Vector2i> segment, f32 epsilon, std::vector<Vector2i>& result) {
-    const usize end = segment.len - 1;
-    if (segment.len == 1) { result.push_back(segment[0]); return; }
-    if (segment.len == 2) { result.push_back(segment[0]); result.push_back(segment[end]); return; }
 
-    f32 dmax = 0;
-    usize index = 0;
-    if (segment[0] == segment[end]) {
-        for (usize i = 1; i < end; i++) {
-            const f32 d = euclid_dist(segment[0], segment[i]);
-            if (d > dmax) {
-                dmax = d;
-                index = i;
-            }
+// the point in (lo, hi) farthest from the line through lo and hi, or from lo itself when both ends are the same
+// point. distances stay squared, the line's ones scaled by its squared length, so there is no sqrt or division
+// per point. the first loop has no branches and runs over plain arrays, so it vectorizes, the second only looks
+// for the first point at the maximum
+template<typename S>
+static usize farthest(const S* xs, const S* ys, usize lo, usize hi, bool closed, S* dist, S& dmax) {
+    const auto x0 = xs[lo];
+    const auto y0 = ys[lo];
+    const auto dx = xs[hi] - x0;
+    const auto dy = ys[hi] - y0;
+    auto m = (S)0;
+    if (closed) {
+        for (usize i = lo + 1; i < hi; i++) {
+            const auto px = xs[i] - x0;
+            const auto py = ys[i] - y0;
+            dist[i] = px * px + py * py;
+            m = dist[i] > m ? dist[i] : m;
         }
     } else {
-        for (usize i = 1; i < end; i++) {
-            const f32 d = perp_dist(segment[0], segment[end], segment[i]);
-            if (d > dmax) {
-                dmax = d;
-                index = i;
-            }
+        for (usize i = lo + 1; i < hi; i++) {
+            const auto num = dy * (xs[i] - x0) - dx * (ys[i] - y0);
+            dist[i] = num * num;
+            m = dist[i] > m ? dist[i] : m;
         }
     }
 
-    if (dmax > epsilon) {
-        douglas_peucker_impl(segment.slice(0, index+1), epsilon, result);
-        result.pop_back();
-        douglas_peucker_impl(segment.slice(index, end+1), epsilon, result);
-        return;
-    } else {
-        result.push_back(segment[0]);
-        result.push_back(segment[end]);
-        return;
+    dmax = m;
+    for (usize i = lo + 1; i < hi; i++) {
+        if (dist[i] == m) { return i; }
     }
+    return lo;
 }
 
-static void douglas_peucker_impl(Slice<Vector2f> segment, f32 epsilon, std::vector<Vector2f>& result) {
-    const usize end = segment.len - 1;
-    if (segment.len == 1) { result.push_back(segment[0]); return; }
-    if (segment.len == 2) { result.push_back(segment[0]); result.push_back(segment[end]); return; }
-
-    f32 dmax = 0;
-    usize index = 0;
-    if (segment[0].cmp(segment[end]) < 0.001f) {
-        for (usize i = 1; i < end; i++) {
-            const f32 d = euclid_dist(segment[0], segment[i]);
-            if (d > dmax) {
-                dmax = d;
-                index = i;
-            }
-        }
-    } else {
-        for (usize i = 1; i < end; i++) {
-            const f32 d = perp_dist(segment[0], segment[end], segment[i]);
-            if (d > dmax) {
-                dmax = d;
-                index = i;
-            }
-        }
+// splits at the farthest point while it is further than epsilon from the chord. ranges wait on an explicit
+// stack instead of the call stack, so contours of any length fit
+template<typename T>
+static void douglas_peucker_impl(Slice<Vector2<T>> segment, f32 epsilon, std::vector<Vector2<T>>& result) {
+    using S = Scalar<T>;
+    if (segment.len <= 2) {
+        for (usize i = 0; i < segment.len; i++) { result.push_back(segment[i]); }
+        return;
     }
 
-    if (dmax > epsilon) {
-        douglas_peucker_impl(segment.slice(0, index+1), epsilon, result);
-        result.pop_back();
-        douglas_peucker_impl(segment.slice(index, end+1), epsilon, result);
-        return;
-    } else {
-        result.push_back(segment[0]);
-        result.push_back(segment[end]);
-        return;
+    const auto n = segment.len;
+    auto xs = std::vector<S>(n);
+    auto ys = std::vector<S>(n);
+    auto dist = std::vector<S>(n);
+    for (usize i = 0; i < n; i++) { xs[i] = (S)segment[i].x; ys[i] = (S)segment[i].y; }
+
+    auto keep = std::vector<u8>(n, 0);
+    keep[0] = 1;
+    keep[n - 1] = 1;
+    const auto eps2 = (S)epsilon * (S)epsilon;
+    auto stack = std::vector<std::pair<usize, usize>>{ { 0, n - 1 } };
+    while (!stack.empty()) {
+        const auto [lo, hi] = stack.back();
+        stack.pop_back();
+        if (hi - lo < 2) { continue; }
+
+        const auto closed = same_end(segment[lo], segment[hi]);
+        auto dmax = (S)0;
+        const auto index = farthest(xs.data(), ys.data(), lo, hi, closed, dist.data(), dmax);
+        const auto dx = xs[hi] - xs[lo];
+        const auto dy = ys[hi] - ys[lo];
+        const auto limit = closed ? eps2 : eps2 * (dx * dx + dy * dy);
+        if (index == lo || (epsilon >= 0.f && dmax <= limit)) { continue; }
+
+        keep[index] = 1;
+        stack.push_back({ index, hi });
+        stack.push_back({ lo, index });
+    }
+
+    for (usize i = 0; i < n; i++) {
+        if (keep[i]) { result.push_back(segment[i]); }
     }
 }
 
@@ -105,5 +107,246 @@ std::vector<Vector2f> douglas_peucker(const std::vector<Vector2f>& segment, f32
     return result;
 }
 
+
+
+// min-heap of vertex ids keyed by their area, each vertex knows its place so it can be moved or taken out
+// when its neighbours change
+class AreaHeap {
+private:
+    std::vector<u32> m_heap;
+    std::vector<u32> m_pos;
+    const std::vector<f64>* p_area;
+
+    bool less(u32 a, u32 b) const { return (*p_area)[m_heap[a]] < (*p_area)[m_heap[b]]; }
+    void swap(u32 a, u32 b) {
+        std::swap(m_heap[a], m_heap[b]);
+        m_pos[m_heap[a]] = a;
+        m_pos[m_heap[b]] = b;
+    }
+    void sift_up(u32 i) {
+        while (i > 0 && less(i, (i - 1) / 2)) { swap(i, (i - 1) / 2); i = (i - 1) / 2; }
+    }
+    void sift_down(u32 i) {
+        const auto n = (u32)m_heap.size();
+        while (true) {
+            auto m = i;
+            if (2 * i + 1 < n && less(2 * i + 1, m)) { m = 2 * i + 1; }
+            if (2 * i + 2 < n && less(2 * i + 2, m)) { m = 2 * i + 2; }
+            if (m == i) { return; }
+            swap(i, m);
+            i = m;
+        }
+    }
+
+public:
+    static constexpr u32 NONE = UINT32_MAX;
+
+    AreaHeap(const std::vector<f64>& area) : m_pos(area.size(), NONE), p_area(&area) {
+        m_heap.reserve(area.size());
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    u32 top() const { return m_heap[0]; }
+    bool contains(u32 v) const { return m_pos[v] != NONE; }
+
+    void push(u32 v) {
+        m_pos[v] = (u32)m_heap.size();
+        m_heap.push_back(v);
+        sift_up(m_pos[v]);
+    }
+    void erase(u32 v) {
+        const auto i = m_pos[v];
+        const auto last = (u32)m_heap.size() - 1;
+        if (i != last) { swap(i, last); }
+        m_heap.pop_back();
+        m_pos[v] = NONE;
+        if (i < m_heap.size()) { update(m_heap[i]); }
+    }
+    // after the area of v changed
+    void update(u32 v) {
+        sift_up(m_pos[v]);
+        sift_down(m_pos[v]);
+    }
+};
+
+
+template<typename T>
+static f64 cross(Vector2<T> a, Vector2<T> b, Vector2<T> c) {
+    return ((f64)b.x - a.x) * ((f64)c.y - a.y) - ((f64)c.x - a.x) * ((f64)b.y - a.y);
 }
 
+template<typename T>
+static f64 area(Vector2<T> a, Vector2<T> b, Vector2<T> c) {
+    return std::abs(cross(a, b, c)) * 0.5;
+}
+
+// the points still on the outlines, bucketed in a uniform grid. cutting a point off can only make its loop cross
+// another outline if some other point lies in the triangle it spans with its neighbours
+template<typename T>
+class PointGrid {
+private:
+    const std::vector<Vector2<T>>* p_points;
+    Vector2<f64> m_min;
+    f64 m_cell = 1.0;
+    usize m_width = 1;
+    usize m_height = 1;
+    std::vector<std::vector<u32>> m_cells;
+
+    usize column(f64 x) const { return std::min((usize)std::max((x - m_min.x) / m_cell, 0.0), m_width - 1); }
+    usize row(f64 y) const { return std::min((usize)std::max((y - m_min.y) / m_cell, 0.0), m_height - 1); }
+    usize cell(Vector2<T> p) const { return row((f64)p.y) * m_width + column((f64)p.x); }
+
+public:
+    PointGrid(const std::vector<Vector2<T>>& points) : p_points(&points) {
+        if (points.empty()) { m_cells.resize(1); return; }
+        auto lo = Vector2<f64>{ (f64)points[0].x, (f64)points[0].y };
+        auto hi = lo;
+        for (const auto& p : points) {
+            lo = Vector2<f64>{ std::min(lo.x, (f64)p.x), std::min(lo.y, (f64)p.y) };
+            hi = Vector2<f64>{ std::max(hi.x, (f64)p.x), std::max(hi.y, (f64)p.y) };
+        }
+        // about two points per cell
+        const auto extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), 1.0);
+        const auto side = std::max(std::sqrt((f64)points.size() / 2.0), 1.0);
+        m_min = lo;
+        m_cell = extent / side;
+        m_width = (usize)((hi.x - lo.x) / m_cell) + 1;
+        m_height = (usize)((hi.y - lo.y) / m_cell) + 1;
+        m_cells.resize(m_width * m_height);
+        for (u32 i = 0; i < points.size(); i++) { m_cells[cell(points[i])].push_back(i); }
+    }
+
+    void erase(u32 v) {
+        auto& bucket = m_cells[cell((*p_points)[v])];
+        const auto it = std::find(bucket.begin(), bucket.end(), v);
+        *it = bucket.back();
+        bucket.pop_back();
+    }
+
+    // any point other than the corners on or inside the triangle a, b, c
+    bool any_inside(u32 a, u32 b, u32 c) const {
+        const auto& pts = *p_points;
+        const auto pa = pts[a];
+        const auto pb = pts[b];
+        const auto pc = pts[c];
+        const auto x0 = (f64)std::min({ pa.x, pb.x, pc.x });
+        const auto x1 = (f64)std::max({ pa.x, pb.x, pc.x });
+        const auto y0 = (f64)std::min({ pa.y, pb.y, pc.y });
+        const auto y1 = (f64)std::max({ pa.y, pb.y, pc.y });
+        const auto turn = cross(pa, pb, pc);
+
+        for (usize r = row(y0); r <= row(y1); r++) {
+            for (usize k = column(x0); k <= column(x1); k++) {
+                for (const auto i : m_cells[r * m_width + k]) {
+                    if (i == a || i == b || i == c) { continue; }
+                    const auto p = pts[i];
+                    if (p.x < x0 || p.x > x1 || p.y < y0 || p.y > y1) { continue; }
+                    // flat triangles are their longest side, the box has already cut that down to the segment
+                    auto d1 = cross(pa, pb, p);
+                    auto d2 = cross(pb, pc, p);
+                    auto d3 = cross(pc, pa, p);
+                    if (turn < 0.0) { d1 = -d1; d2 = -d2; d3 = -d3; }
+                    if (turn == 0.0 ? d1 == 0.0 && d2 == 0.0 && d3 == 0.0 : d1 >= 0.0 && d2 >= 0.0 && d3 >= 0.0) { return true; }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// every point of every loop goes into one heap, so the budget is spent where the outlines are least detailed,
+// whichever loop that is. a point's area never drops below that of a neighbour taken out before it, so points
+// next to removed ones go in the order their part of the outline is flattened. points that cannot go without
+// the outlines crossing leave the heap until one of their neighbours goes
+template<typename T>
+static std::vector<std::vector<Vector2<T>>> visvalingam_impl(const std::vector<std::vector<Vector2<T>>>& outlines, f32 tolerance, usize budget) {
+    auto points = std::vector<Vector2<T>>();
+    auto loop = std::vector<u32>();
+    auto first = std::vector<u32>();
+    auto count = std::vector<u32>();
+    for (const auto& o : outlines) {
+        const auto n = o.size() > 1 && o.front() == o.back() ? o.size() - 1 : o.size();
+        first.push_back((u32)points.size());
+        count.push_back((u32)n);
+        for (usize i = 0; i < n; i++) {
+            points.push_back(o[i]);
+            loop.push_back((u32)first.size() - 1);
+        }
+    }
+
+    const auto total = (u32)points.size();
+    auto prev = std::vector<u32>(total);
+    auto next = std::vector<u32>(total);
+    auto areas = std::vector<f64>(total, std::numeric_limits<f64>::infinity());
+    for (usize l = 0; l < first.size(); l++) {
+        const auto f = first[l];
+        const auto n = count[l];
+        for (u32 i = 0; i < n; i++) {
+            prev[f + i] = f + (i + n - 1) % n;
+            next[f + i] = f + (i + 1) % n;
+        }
+    }
+
+    auto heap = AreaHeap(areas);
+    for (u32 v = 0; v < total; v++) {
+        if (count[loop[v]] <= 3) { continue; }
+        areas[v] = area(points[prev[v]], points[v], points[next[v]]);
+        heap.push(v);
+    }
+    const auto grid = budget > 0 || tolerance > 0.f ? std::make_unique<PointGrid<T>>(points) : nullptr;
+
+    // a neighbour of a removed point spans a new triangle, which may not be blocked any more
+    const auto reweigh = [&](u32 v, f64 floor) {
+        areas[v] = std::max(area(points[prev[v]], points[v], points[next[v]]), floor);
+        if (heap.contains(v)) { heap.update(v); } else { heap.push(v); }
+    };
+
+    usize left = total;
+    while (!heap.empty()) {
+        const auto v = heap.top();
+        if (areas[v] > (f64)tolerance && (budget == 0 || left <= budget)) { break; }
+
+        heap.erase(v);
+        const auto p = prev[v];
+        const auto n = next[v];
+        if (grid && grid->any_inside(p, v, n)) { continue; }
+        if (grid) { grid->erase(v); }
+        next[p] = n;
+        prev[n] = p;
+        left--;
+
+        const auto l = loop[v];
+        first[l] = p;
+        if (--count[l] == 3) {
+            for (const auto u : { p, n, next[n] }) {
+                if (heap.contains(u)) { heap.erase(u); }
+            }
+            continue;
+        }
+        reweigh(p, areas[v]);
+        reweigh(n, areas[v]);
+    }
+
+    auto result = std::vector<std::vector<Vector2<T>>>(outlines.size());
+    for (usize l = 0; l < first.size(); l++) {
+        if (count[l] == 0) { continue; }
+        // start the loop at its earliest point left, so it begins where it did
+        auto start = first[l];
+        for (u32 i = 0, v = start; i < count[l]; i++, v = next[v]) { start = std::min(start, v); }
+        auto& out = result[l];
+        out.reserve(count[l] + 1);
+        for (u32 i = 0, v = start; i < count[l]; i++, v = next[v]) { out.push_back(points[v]); }
+        if (!outlines[l].empty() && outlines[l].front() == outlines[l].back()) { out.push_back(out.front()); }
+    }
+    return result;
+}
+
+std::vector<std::vector<Vector2i>> visvalingam_whyatt(const std::vector<std::vector<Vector2i>>& outlines, f32 tolerance, usize budget) {
+    return visvalingam_impl(outlines, tolerance, budget);
+}
+
+std::vector<std::vector<Vector2f>> visvalingam_whyatt(const std::vector<std::vector<Vector2f>>& outlines, f32 tolerance, usize budget) {
+    return visvalingam_impl(outlines, tolerance, budget);
+}
+
+}
@@ -7,5 +7,12 @@ namespace nav {
 std::vector<Vector2i> douglas_peucker(const std::vector<Vector2i>& segment, f32 epsilon);
 std::vector<Vector2f> douglas_peucker(const std::vector<Vector2f>& segment, f32 epsilon);
 
+// drops the points spanning the smallest triangles with their neighbours, over all outlines together, until every
+// point left spans more than tolerance or, with a budget, until no more than budget points are left. outlines are
+// loops, closed ones repeat their first point at the end. none is cut below 3 points and no point goes if that
+// would make outlines cross, so a budget too small for the map is not reached
+std::vector<std::vector<Vector2i>> visvalingam_whyatt(const std::vector<std::vector<Vector2i>>& outlines, f32 tolerance, usize budget);
+std::vector<std::vector<Vector2f>> visvalingam_whyatt(const std::vector<std::vector<Vector2f>>& outlines, f32 tolerance, usize budget);
+
 }
 
@@ -0,0 +1,70 @@
+#include "spatial.h"
+
+
+namespace nav {
+
+SpatialHash::SpatialHash(f32 cell_size, usize buckets) : m_cell(cell_size) {
+    usize n = 1;
+    while (n < buckets) { n <<= 1; }
+    m_mask = (u32)(n - 1);
+}
+
+
+// m_keys[i] is the bucket of entry i, m_owner[i] its item id
+void SpatialHash::sort_keys(usize buckets) {
+    m_start.assign(buckets + 1, 0);
+    for (const auto k : m_keys) { m_start[k + 1]++; }
+    for (usize i = 0; i < buckets; i++) { m_start[i + 1] += m_start[i]; }
+
+    m_items.resize(m_keys.size());
+    m_slot.resize(m_keys.size());
+    auto cursor = std::vector<u32>(m_start.begin(), m_start.end() - 1);
+    for (usize i = 0; i < m_keys.size(); i++) {
+        m_slot[i] = cursor[m_keys[i]]++;
+        m_items[m_slot[i]] = m_owner[i];
+    }
+}
+
+void SpatialHash::build(const f32* xs, const f32* ys, usize count) {
+    m_keys.resize(count);
+    m_owner.resize(count);
+    for (usize i = 0; i < count; i++) {
+        m_keys[i] = bucket_of(cell_of(Vector2f{ xs[i], ys[i] }));
+        m_owner[i] = (u32)i;
+    }
+    sort_keys(m_mask + 1);
+
+    m_pos.resize(count);
+    for (usize i = 0; i < count; i++) {
+        m_pos[m_slot[i]] = Vector2f{ xs[i], ys[i] };
+    }
+}
+
+void SpatialHash::update(const f32* xs, const f32* ys, usize count) {
+    if (count != m_pos.size()) { build(xs, ys, count); return; }
+    for (usize i = 0; i < count; i++) {
+        if (bucket_of(cell_of(Vector2f{ xs[i], ys[i] })) != m_keys[i]) { build(xs, ys, count); return; }
+    }
+    for (usize i = 0; i < count; i++) {
+        m_pos[m_slot[i]] = Vector2f{ xs[i], ys[i] };
+    }
+}
+
+void SpatialHash::build(const Vector2f* a, const Vector2f* b, usize count) {
+    m_keys.clear();
+    m_owner.clear();
+    m_pos.clear();
+    for (usize i = 0; i < count; i++) {
+        const auto lo = cell_of(Vector2f{ std::min(a[i].x, b[i].x), std::min(a[i].y, b[i].y) });
+        const auto hi = cell_of(Vector2f{ std::max(a[i].x, b[i].x), std::max(a[i].y, b[i].y) });
+        for (i32 y = lo.y; y <= hi.y; y++) {
+            for (i32 x = lo.x; x <= hi.x; x++) {
+                m_keys.push_back(bucket_of(Vector2i{ x, y }));
+                m_owner.push_back((u32)i);
+            }
+        }
+    }
+    sort_keys(m_mask + 1);
+}
+
+}
@@ -1,6 +1,6 @@
 #include "lib.h"
+#include <BS_thread_pool.hpp>
 #include <CDT/CDT.h>
-#include "gen_internal.h"
 #include "simplify.h"
 
 #include "bench.h"
@@ -8,12 +8,6 @@
 
 namespace nav {
 
-struct Edge {
-    usize a;
-    usize b;
-};
-
-
 static bool collinear(Vector2i a, Vector2i b, Vector2i c) {
     return (b.y - a.y) * (c.x - b.x) == (c.y - b.y) * (b.x - a.x);
 }
@@ -45,139 +39,79 @@ static std::pair<size_t, size_t> shared_edge(const CDT::Triangle& a, const CDT::
 }
 
 
-Mesh generate_delauney(
-        const uint8_t* grid,
-        size_t width,
-        size_t height,
-        size_t stride,
-        Predicate P,
-        Method method,
-        float epsilon)
-{
-    // BENCH_BEGIN;
-
-    auto polys = method == Method::MARCHING_SQUARES ?
-        marching_squares(grid, width, height, stride, P) :
-        floodfill(grid, width, height, stride, P);
-
-    // BENCH_STEP("polygon construction");
-
-    auto verts = std::vector<Vector2i>();
-    auto edges = std::vector<Edge>();
-
-    size_t offset = 0;
-    for (auto& p : polys) {
-        auto dp = douglas_peucker(p, epsilon);
-        if (dp.front() == dp.back()) { dp.pop_back(); }
-        if (collinear(dp[dp.size()-1], dp[0], dp[1])) { dp.erase(dp.begin()); }
-        else if (collinear(dp[dp.size()-2], dp[dp.size()-1], dp[0])) { dp.pop_back(); }
-
-        size_t i = 0;
-        for (const auto& v : dp) {
-            verts.push_back(v);
-            edges.push_back(Edge{ offset + i, offset + ((i + 1) % (dp.size())) });
-            i++;
-        }
-
-        offset += dp.size();
+// douglas-peucker simplifies every outline on its own, so with a pool they are spread over its threads.
+// visvalingam-whyatt weighs the points of all outlines against each other, so it runs on all of them at once
+template<typename T>
+static std::vector<std::vector<Vector2<T>>> simplify_all(const std::vector<std::vector<Vector2<T>>>& polys, Simplification simplify, ThreadPool* pool) {
+    if (simplify.method == Simplifier::VISVALINGAM_WHYATT) {
+        return visvalingam_whyatt(polys, simplify.tolerance, simplify.budget);
     }
 
-    // BENCH_STEP("simplify & prepare");
-
-    auto cdt = CDT::Triangulation<float>();
-    cdt.insertVertices(
-        verts.begin(),
-        verts.end(),
-        [](const Vector2i& p){ return (f32)p.x; },
-        [](const Vector2i& p){ return (f32)p.y; }
-    );
-    cdt.insertEdges(
-        edges.begin(),
-        edges.end(),
-        [](const Edge& e){ return e.a; },
-        [](const Edge& e){ return e.b; }
-    );
-    cdt.eraseOuterTrianglesAndHoles();
-
-    // BENCH_STEP("triangulation");
+    auto result = std::vector<std::vector<Vector2<T>>>(polys.size());
+    const auto run = [&](usize lo, usize hi) {
+        for (usize i = lo; i < hi; i++) { result[i] = douglas_peucker(polys[i], simplify.tolerance); }
+    };
+    if (pool && polys.size() > 1) {
+        pool->submit_blocks((usize)0, polys.size(), run, pool->get_thread_count() * 4).wait();
+    } else {
+        run(0, polys.size());
+    }
+    return result;
+}
 
+// every triangle looks up its own portals, so with a pool they are filled in side by side
+static Mesh extract_mesh(const CDT::Triangulation<float>& cdt, f32 scale, ThreadPool* pool) {
     auto mesh = Mesh();
+    mesh.vertices.reserve(cdt.vertices.size());
     for (const auto& vert : cdt.vertices) {
-        mesh.vertices.push_back(Vector2f{ vert.x * 0.1f, vert.y * 0.1f });
+        mesh.vertices.push_back(Vector2f{ vert.x * scale, vert.y * scale });
     }
-    for (const auto& tri : cdt.triangles) {
-        mesh.triangles.push_back(Triangle{
-            tri.vertices[0],
-            tri.vertices[1],
-            tri.vertices[2],
-        });
-        auto ns = std::vector<Mesh::Edge>();
-        if (tri.neighbors[0] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[0]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[0],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[1] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[1]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[1],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[2] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[2]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[2],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
+    mesh.triangles.resize(cdt.triangles.size());
+    mesh.edges.resize(cdt.triangles.size());
+
+    const auto run = [&](usize lo, usize hi) {
+        for (usize i = lo; i < hi; i++) {
+            const auto& tri = cdt.triangles[i];
+            mesh.triangles[i] = Triangle{
+                tri.vertices[0],
+                tri.vertices[1],
+                tri.vertices[2],
+            };
+            auto& ns = mesh.edges[i];
+            for (const auto n : tri.neighbors) {
+                if (n == CDT::noNeighbor) { continue; }
+                const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[n]);
+                const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * scale;
+                const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * scale;
+                ns.push_back(Mesh::Edge{
+                    n,
+                    v1 + (v2 - v1) / 2,
+                    _v1, _v2,
+                    (v2 - v1).length(),
+                });
+            }
         }
-
-        mesh.edges.push_back(ns);
+    };
+    if (pool && cdt.triangles.size() > 1) {
+        pool->submit_blocks((usize)0, cdt.triangles.size(), run, pool->get_thread_count() * 4).wait();
+    } else {
+        run(0, cdt.triangles.size());
     }
-
-    // BENCH_STEP("data extraction");
+    mesh.bake_clearance();
 
     return mesh;
 }
 
-Mesh generate_delauney(
-        const uint8_t* grid,
-        size_t width,
-        size_t height,
-        size_t stride,
-        size_t index,
-        Method method,
-        float epsilon)
-{
-    BENCH_BEGIN;
-
-    const auto len = width * height;
-
-    auto polys = method == Method::MARCHING_SQUARES ?
-        marching_squares(grid, width, height, stride, index) :
-            len > 400 * 400 ?
-                floodfill_threaded(grid, width, height, stride, index) :
-                floodfill(grid, width, height, stride, index);
 
-    BENCH_STEP("polygon construction");
+static Mesh triangulate_outlines(const std::vector<Polygon>& polys, Simplification simplify, ThreadPool* pool) {
+    BENCH_BEGIN;
 
+    const auto simple = simplify_all(polys, simplify, pool);
     auto verts = std::vector<CDT::V2d<f32>>();
     auto edges = std::vector<CDT::Edge>();
 
     u32 offset = 0;
-    for (auto& p : polys) {
-        auto dp = douglas_peucker(p, epsilon);
+    for (auto dp : simple) {
         if (dp.front() == dp.back()) { dp.pop_back(); }
         if (collinear(dp[dp.size()-1], dp[0], dp[1])) { dp.erase(dp.begin()); }
         else if (collinear(dp[dp.size()-2], dp[dp.size()-1], dp[0])) { dp.pop_back(); }
@@ -203,54 +137,7 @@ Mesh generate_delauney(
 
     BENCH_STEP("triangulation");
 
-    auto mesh = Mesh();
-    mesh.vertices.reserve(cdt.vertices.size());
-    mesh.triangles.reserve(cdt.triangles.size());
-    mesh.edges.reserve(cdt.triangles.size());
-
-    for (const auto& vert : cdt.vertices) {
-        mesh.vertices.push_back(Vector2f{ vert.x * 0.1f, vert.y * 0.1f });
-    }
-    for (const auto& tri : cdt.triangles) {
-        mesh.triangles.push_back(Triangle{
-            tri.vertices[0],
-            tri.vertices[1],
-            tri.vertices[2],
-        });
-        auto ns = std::vector<Mesh::Edge>();
-        if (tri.neighbors[0] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[0]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[0],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[1] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[1]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[1],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[2] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[2]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y } * 0.1f;
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y } * 0.1f;
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[2],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-
-        mesh.edges.push_back(ns);
-    }
+    auto mesh = extract_mesh(cdt, 0.1f, pool);
 
     BENCH_STEP("data extraction");
 
@@ -258,24 +145,80 @@ Mesh generate_delauney(
 }
 
 
+Mesh triangulate_mask(const WallMask& mask, Method method, Simplification simplify, ThreadPool* pool) {
+    const auto polys = method == Method::MARCHING_SQUARES ? marching_squares(mask, pool) : floodfill(mask, pool);
+    return triangulate_outlines(polys, simplify, pool);
+}
+
+
+Mesh generate_delauney(
+        const uint8_t* grid,
+        size_t width,
+        size_t height,
+        size_t stride,
+        Predicate P,
+        Method method,
+        Simplification simplify)
+{
+    return generate_delauney(grid, width, height, stride, [P](const u8* cell){ return P(cell); }, method, simplify);
+}
+
+Mesh generate_delauney(
+        const uint8_t* grid,
+        size_t width,
+        size_t height,
+        size_t stride,
+        size_t index,
+        Method method,
+        Simplification simplify)
+{
+    return generate_delauney(grid, width, height, stride, [index](const u8* cell){ return cell[index] != 0; }, method, simplify);
+}
+
+Mesh generate_delauney(
+        const uint8_t* grid,
+        size_t width,
+        size_t height,
+        size_t stride,
+        Predicate P,
+        Method method,
+        Simplification simplify,
+        ThreadPool& pool)
+{
+    return generate_delauney(grid, width, height, stride, [P](const u8* cell){ return P(cell); }, method, simplify, pool);
+}
+
+Mesh generate_delauney(
+        const uint8_t* grid,
+        size_t width,
+        size_t height,
+        size_t stride,
+        size_t index,
+        Method method,
+        Simplification simplify,
+        ThreadPool& pool)
+{
+    return generate_delauney(grid, width, height, stride, [index](const u8* cell){ return cell[index] != 0; }, method, simplify, pool);
+}
+
+
 #define PI 3.1415f
 #define TAU (2.f * PI)
 
-Mesh generate_from_shapes(
+static Mesh from_shapes(
         const std::vector<std::vector<Vector2f>>& polys,
         const std::vector<FloatCircle>& circles,
         const std::vector<Vector2f>& fillers,
         u32 circle_res,
-        float epsilon
+        float epsilon,
+        ThreadPool* pool
     )
 {
     auto verts = std::vector<CDT::V2d<f32>>();
     auto edges = std::vector<CDT::Edge>();
-    auto cons = std::vector<CDT::Edge>();
 
     u32 offset = 0;
-    for (auto& p : polys) {
-        auto dp = douglas_peucker(p, epsilon);
+    for (const auto& dp : simplify_all(polys, epsilon, pool)) {
         verts.reserve(verts.size() + dp.size());
         edges.reserve(edges.size() + dp.size());
         u32 i = 0;
@@ -312,57 +255,30 @@ Mesh generate_from_shapes(
     cdt.insertEdges(edges);
     cdt.eraseOuterTriangles();
 
-    auto mesh = Mesh();
-    mesh.vertices.reserve(cdt.vertices.size());
-    mesh.triangles.reserve(cdt.triangles.size());
-    mesh.edges.reserve(cdt.triangles.size());
-
-    for (const auto& vert : cdt.vertices) {
-        mesh.vertices.push_back(Vector2f{ vert.x, vert.y });
-    }
-    for (const auto& tri : cdt.triangles) {
-        mesh.triangles.push_back(Triangle{
-            tri.vertices[0],
-            tri.vertices[1],
-            tri.vertices[2],
-        });
-        auto ns = std::vector<Mesh::Edge>();
-        if (tri.neighbors[0] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[0]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y };
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y };
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[0],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[1] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[1]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y };
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y };
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[1],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-        if (tri.neighbors[2] != CDT::noNeighbor) {
-            const auto [_v1, _v2] = shared_edge(tri, cdt.triangles[tri.neighbors[2]]);
-            const auto v1 = Vector2f{ cdt.vertices[_v1].x, cdt.vertices[_v1].y };
-            const auto v2 = Vector2f{ cdt.vertices[_v2].x, cdt.vertices[_v2].y };
-            ns.push_back(Mesh::Edge{
-                tri.neighbors[2],
-                v1 + (v2 - v1) / 2,
-                _v1, _v2,
-            });
-        }
-
-        mesh.edges.push_back(ns);
-    }
+    return extract_mesh(cdt, 1.f, pool);
+}
 
-    return mesh;
+Mesh generate_from_shapes(
+        const std::vector<std::vector<Vector2f>>& polys,
+        const std::vector<FloatCircle>& circles,
+        const std::vector<Vector2f>& fillers,
+        u32 circle_res,
+        float epsilon
+    )
+{
+    return from_shapes(polys, circles, fillers, circle_res, epsilon, nullptr);
 }
 
+Mesh generate_from_shapes(
+        const std::vector<std::vector<Vector2f>>& polys,
+        const std::vector<FloatCircle>& circles,
+        const std::vector<Vector2f>& fillers,
+        ThreadPool& pool,
+        u32 circle_res,
+        float epsilon
+    )
+{
+    return from_shapes(polys, circles, fillers, circle_res, epsilon, &pool);
 }
 
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+
+
+// every file in tests/ is its own program, linked against the library built with SHMY_NAV_GENERATION.
+// the ones that create a thread pool also need lib/thread-pool/include, and the ones that test a header from src/
+// need include/navmesh as well, as the sources do.
+// failed checks are reported and counted, and main returns non-zero if there were any
+inline int& failures() { static int count = 0; return count; }
+
+#define CHECK(cond) do { \
+        if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures()++; } \
+    } while (0)
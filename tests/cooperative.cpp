@@ -0,0 +1,82 @@
+#include "check.h"
+#include "maps.h"
+#include <navmesh/cooperative.h>
+
+using namespace nav;
+
+
+// hold[i] is the slot the plan enters corridor[i] in, so the last one is when it arrives
+static u32 arrival(const std::vector<u32>& hold) {
+    return hold.empty() ? 0 : hold.back();
+}
+
+// reservations belong to the seat's owner id, not to wherever the seat lives: they move with it
+// and are gone once it is destroyed
+static void seats_own_reservations(const Mesh& mesh, Vector2f left, Vector2f right) {
+    auto table = ReservationTable(&mesh, 0.5f, 64);
+    auto corridor = std::vector<CrossInfo>();
+    auto hold = std::vector<u32>();
+    const auto left_tri = *mesh.get_triangle(left);
+    const auto right_tri = *mesh.get_triangle(right);
+    auto other = TableSeat(table);
+    CHECK(table.plan(other.get_owner(), right_tri, right, left, 2.f, 0.4f, corridor, hold));
+    const auto alone = arrival(hold);
+    table.release(other.get_owner());
+    {
+        auto first = TableSeat(table);
+        CHECK(first.get_owner() != other.get_owner());
+        CHECK(table.plan(first.get_owner(), left_tri, left, right, 2.f, 0.4f, corridor, hold));
+
+        auto moved = std::move(first);
+        CHECK(first.get_table() == nullptr);
+        CHECK(table.plan(other.get_owner(), right_tri, right, left, 2.f, 0.4f, corridor, hold));
+        CHECK(arrival(hold) > alone);
+    }
+    CHECK(table.plan(other.get_owner(), right_tri, right, left, 2.f, 0.4f, corridor, hold));
+    CHECK(arrival(hold) == alone);
+}
+
+// agents meeting head on in a corridor one triangle wide take turns: no triangle is held by more agents in a slot
+// than it fits. planned in separate tables, without seeing each other, the same two trips would collide
+static void meeting_in_a_corridor(const Mesh& mesh, Vector2f left, Vector2f right) {
+    const auto radius = 0.4f;
+    auto shared = ReservationTable(&mesh, 0.5f, 64);
+    auto only_a = ReservationTable(&mesh, 0.5f, 64);
+    auto only_b = ReservationTable(&mesh, 0.5f, 64);
+    auto corridor = std::vector<CrossInfo>();
+    auto hold = std::vector<u32>();
+    const auto plan = [&](ReservationTable& table, const TableSeat& seat, Vector2f begin, Vector2f end) {
+        CHECK(table.plan(seat.get_owner(), *mesh.get_triangle(begin), begin, end, 2.f, radius, corridor, hold));
+    };
+    const auto a = TableSeat(shared);
+    const auto b = TableSeat(shared);
+    const auto lone_a = TableSeat(only_a);
+    const auto lone_b = TableSeat(only_b);
+    plan(shared, a, left, right);
+    plan(shared, b, right, left);
+    plan(only_a, lone_a, left, right);
+    plan(only_b, lone_b, right, left);
+
+    usize narrow = 0;
+    usize collisions = 0;
+    for (usize tri = 0; tri < mesh.triangles.size(); tri++) {
+        const auto fits = shared.capacity(tri, radius);
+        narrow += fits == 1;
+        for (u32 slot = 0; slot < shared.get_window(); slot++) {
+            CHECK(shared.get_reserved(tri, slot) <= fits);
+            collisions += only_a.get_reserved(tri, slot) + only_b.get_reserved(tri, slot) > fits;
+        }
+    }
+    CHECK(narrow > 0);
+    CHECK(collisions > 0);
+}
+
+int main() {
+    const auto mesh = corridor_mesh(8, 12);
+    const auto left = Vector2f{ 2.5f, 5.5f };
+    const auto right = Vector2f{ 27.5f, 5.5f };
+    seats_own_reservations(mesh, left, right);
+    meeting_in_a_corridor(mesh, left, right);
+    std::printf("cooperative: %d failed\n", failures());
+    return failures() != 0;
+}
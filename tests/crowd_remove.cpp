@@ -0,0 +1,43 @@
+#include "check.h"
+#include "maps.h"
+#include <navmesh/crowd.h>
+#include <algorithm>
+
+using namespace nav;
+
+
+int main() {
+    const auto mesh = block_mesh(48, 1);
+    auto crowd = Crowd(&mesh);
+
+    const auto a = crowd.add(Vector2f{ 1.5f, 1.5f });
+    const auto b = crowd.add(Vector2f{ 2.5f, 1.5f });
+    CHECK(a.has_value() && b.has_value());
+    if (!a || !b) { return 1; }
+
+    // removing twice frees the slot once, so the next two agents get different slots
+    crowd.remove(*a);
+    crowd.remove(*a);
+    CHECK(!crowd.is_active(*a));
+    const auto c = crowd.add(Vector2f{ 1.5f, 2.5f });
+    const auto d = crowd.add(Vector2f{ 2.5f, 2.5f });
+    CHECK(c.has_value() && d.has_value());
+    if (c && d) {
+        CHECK(*c != *d);
+        CHECK(*c == *a);
+        CHECK(*d != *b);
+        CHECK(crowd.is_active(*b) && crowd.is_active(*c) && crowd.is_active(*d));
+    }
+
+    // a queued replan for a removed agent is dropped, and does not carry over to the agent in its slot
+    crowd.request_target_position(*b, Vector2f{ 40.5f, 40.5f });
+    crowd.remove(*b);
+    crowd.update(1.f / 60.f);
+    CHECK(crowd.pending_replans() == 0);
+    CHECK(!crowd.is_active(*b));
+    const auto e = crowd.add(Vector2f{ 2.5f, 1.5f });
+    CHECK(e.has_value() && *e == *b && !crowd.is_moving(*e));
+
+    std::printf("crowd_remove: %d failed\n", failures());
+    return failures() != 0;
+}
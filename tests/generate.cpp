@@ -0,0 +1,82 @@
+#include "check.h"
+#include "maps.h"
+#include <BS_thread_pool.hpp>
+
+using namespace nav;
+
+
+// walls the rectangle of w x h cells at x, y if it and a cell all around it are free, like the blocks of
+// block_grid, so outlines never pinch
+static void stamp(std::vector<u8>& grid, usize size, usize x, usize y, usize w, usize h) {
+    if (x < 2 || y < 2 || x + w + 2 > size || y + h + 2 > size) { return; }
+    for (auto yy = y - 1; yy <= y + h; yy++) {
+        for (auto xx = x - 1; xx <= x + w; xx++) {
+            if (grid[yy * size + xx]) { return; }
+        }
+    }
+    for (auto yy = y; yy < y + h; yy++) {
+        for (auto xx = x; xx < x + w; xx++) { grid[yy * size + xx] = 1; }
+    }
+}
+
+// block_grid with, at every seam between bands of block rows, blocks that start and end on each row around it:
+// their corners fall on the seams, and the walls running across them leave points in the middle of a side
+static std::vector<u8> seam_grid(usize size, u32 seed, usize block) {
+    auto grid = block_grid(size, seed);
+    for (auto seam = block; seam < size; seam += block) {
+        usize x = 4;
+        for (usize d = 0; d < 6; d++) {
+            for (usize h = 1; h <= 3; h++) {
+                stamp(grid, size, x, seam + d - 3, 1 + h % 2, h);
+                stamp(grid, size, x + 4, seam + d - 3 - h, 2, h);
+                x += 9;
+            }
+        }
+        stamp(grid, size, x, seam - 5, 1, 10);
+        stamp(grid, size, x + 4, seam - 5, 3, 10);
+    }
+    return grid;
+}
+
+static bool same_mesh(const Mesh& a, const Mesh& b) {
+    if (a.vertices.size() != b.vertices.size() || a.triangles.size() != b.triangles.size()) { return false; }
+    for (usize i = 0; i < a.vertices.size(); i++) {
+        if (a.vertices[i].x != b.vertices[i].x || a.vertices[i].y != b.vertices[i].y) { return false; }
+    }
+    for (usize i = 0; i < a.triangles.size(); i++) {
+        const auto& s = a.triangles[i];
+        const auto& t = b.triangles[i];
+        if (s.A != t.A || s.B != t.B || s.C != t.C) { return false; }
+    }
+    return true;
+}
+
+// the pool splits the grid into bands of rows that are traced apart and stitched back together. the outlines
+// and the mesh must come out as if it were traced in one go
+static void pooled_is_serial(usize size, u32 seed, ThreadPool& pool) {
+    const auto block = band_rows(size, size, pool);
+    CHECK(block < size);
+    const auto grid = seam_grid(size, seed, block);
+    const auto is_wall = [](const u8* cell) { return *cell != 0; };
+    const auto serial = build_mask(grid.data(), size, size, 1, is_wall, nullptr);
+    const auto pooled = build_mask(grid.data(), size, size, 1, is_wall, &pool);
+    CHECK(serial.bits == pooled.bits);
+
+    CHECK(marching_squares(serial, nullptr) == marching_squares(serial, &pool));
+    CHECK(floodfill(serial, nullptr) == floodfill(serial, &pool));
+    for (const auto method : { Method::MARCHING_SQUARES, Method::FLOODFILL }) {
+        const auto one = generate_delauney(grid.data(), size, size, 1, is_wall, method, 0.f);
+        const auto many = generate_delauney(grid.data(), size, size, 1, is_wall, method, 0.f, pool);
+        CHECK(!one.triangles.empty());
+        CHECK(same_mesh(one, many));
+    }
+}
+
+int main() {
+    auto pool = ThreadPool(4);
+    for (u32 seed = 1; seed <= 3; seed++) {
+        pooled_is_serial(600, seed, pool);
+    }
+    std::printf("generate: %d failed\n", failures());
+    return failures() != 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <navmesh/lib.h>
+#include <random>
+
+
+// a size x size grid walled at the rim, with rectangular blocks scattered over it. the blocks never touch
+// diagonally, so the outlines have no pinch points
+inline std::vector<nav::u8> block_grid(nav::usize size, nav::u32 seed) {
+    auto rng = std::mt19937(seed);
+    auto grid = std::vector<nav::u8>(size * size, 0);
+    for (nav::usize i = 0; i < size; i++) {
+        grid[i] = grid[(size - 1) * size + i] = 1;
+        grid[i * size] = grid[i * size + size - 1] = 1;
+    }
+    for (nav::usize b = 0; b < size / 4; b++) {
+        const auto x = 3 + rng() % (size - 12);
+        const auto y = 3 + rng() % (size - 12);
+        const auto w = 1 + rng() % 6;
+        const auto h = 1 + rng() % 6;
+        // keep a free cell all around so blocks only merge along whole sides
+        auto clear = true;
+        for (auto yy = y - 1; yy <= y + h; yy++) {
+            for (auto xx = x - 1; xx <= x + w; xx++) { clear = clear && grid[yy * size + xx] == 0; }
+        }
+        if (!clear) { continue; }
+        for (auto yy = y; yy < y + h; yy++) {
+            for (auto xx = x; xx < x + w; xx++) { grid[yy * size + xx] = 1; }
+        }
+    }
+    return grid;
+}
+
+inline nav::Mesh block_mesh(nav::usize size, nav::u32 seed) {
+    const auto grid = block_grid(size, seed);
+    return nav::generate_delauney(grid.data(), size, size, 1, (nav::usize)0, nav::Method::FLOODFILL, 0.f);
+}
+
+// two square rooms of room x room cells, joined by a corridor one cell wide and length cells long
+inline nav::Mesh corridor_mesh(nav::usize room, nav::usize length) {
+    const auto width = 2 * room + length + 2;
+    const auto height = room + 2;
+    auto grid = std::vector<nav::u8>(width * height, 1);
+    for (nav::usize y = 1; y <= room; y++) {
+        for (nav::usize x = 1; x <= room; x++) {
+            grid[y * width + x] = 0;
+            grid[y * width + x + room + length] = 0;
+        }
+    }
+    for (nav::usize x = room + 1; x <= room + length; x++) { grid[(room / 2 + 1) * width + x] = 0; }
+    return nav::generate_delauney(grid.data(), width, height, 1, (nav::usize)0, nav::Method::FLOODFILL, 0.f);
+}
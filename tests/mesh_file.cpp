@@ -0,0 +1,80 @@
+#include "check.h"
+#include "maps.h"
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+
+using namespace nav;
+
+
+static bool same_mesh(const Mesh& a, const Mesh& b) {
+    if (a.vertices.size() != b.vertices.size() || a.triangles.size() != b.triangles.size() || a.edges.size() != b.edges.size()) { return false; }
+    for (usize i = 0; i < a.vertices.size(); i++) {
+        if ((a.vertices[i] - b.vertices[i]).length() > 1e-4f) { return false; }
+    }
+    for (usize i = 0; i < a.triangles.size(); i++) {
+        const auto& s = a.triangles[i];
+        const auto& t = b.triangles[i];
+        if (s.A != t.A || s.B != t.B || s.C != t.C || std::abs(s.clearance - t.clearance) > 1e-4f) { return false; }
+        if (a.edges[i].size() != b.edges[i].size()) { return false; }
+        for (usize j = 0; j < a.edges[i].size(); j++) {
+            const auto& e = a.edges[i][j];
+            const auto& f = b.edges[i][j];
+            if (e.index != f.index || e.a != f.a || e.b != f.b || std::abs(e.width - f.width) > 1e-4f) { return false; }
+        }
+    }
+    return true;
+}
+
+// the layout before the format had a header: counts and raw structs, edges without a width
+static void write_v1(const Mesh& mesh, const char* filename) {
+    struct EdgeV1 { usize index; Vector2f center; usize a; usize b; };
+    auto f = std::ofstream(filename, std::ios::binary);
+    const auto tris = mesh.triangles.size();
+    f.write((const char*)&tris, sizeof(usize));
+    for (auto t : mesh.triangles) {
+        t.clearance = 12345.f;
+        f.write((const char*)&t, sizeof(Triangle));
+    }
+    const auto verts = mesh.vertices.size();
+    f.write((const char*)&verts, sizeof(usize));
+    f.write((const char*)mesh.vertices.data(), verts * sizeof(Vector2f));
+    const auto edges = mesh.edges.size();
+    f.write((const char*)&edges, sizeof(usize));
+    for (const auto& es : mesh.edges) {
+        for (usize i = 0; i < 3; i++) {
+            const auto e = i < es.size() ? EdgeV1{ es[i].index, es[i].center, es[i].a, es[i].b } : EdgeV1{ SIZE_MAX, {}, 0, 0 };
+            f.write((const char*)&e, sizeof(EdgeV1));
+        }
+    }
+}
+
+
+int main() {
+    const auto mesh = block_mesh(40, 3);
+
+    mesh.write_file("mesh_file_test.bin", 2.f);
+    CHECK(same_mesh(mesh, Mesh::read_file("mesh_file_test.bin", 2.f)));
+
+    write_v1(mesh, "mesh_file_test_v1.bin");
+    CHECK(same_mesh(mesh, Mesh::read_file("mesh_file_test_v1.bin")));
+
+    {
+        auto f = std::ofstream("mesh_file_test_v9.bin", std::ios::binary);
+        const u32 header[2] = { 0x4D56414E, 9 };
+        f.write((const char*)header, sizeof(header));
+    }
+    CHECK(Mesh::read_file("mesh_file_test_v9.bin").triangles.empty());
+    CHECK(Mesh::read_file("mesh_file_test_missing.bin").triangles.empty());
+
+    // clearance is the narrowest way through, never more than half of any portal
+    for (usize i = 0; i < mesh.triangles.size(); i++) {
+        for (const auto& e : mesh.edges[i]) { CHECK(mesh.triangles[i].clearance <= e.width * 0.5f); }
+    }
+
+    std::remove("mesh_file_test.bin");
+    std::remove("mesh_file_test_v1.bin");
+    std::remove("mesh_file_test_v9.bin");
+    std::printf("mesh_file: %d failed\n", failures());
+    return failures() != 0;
+}
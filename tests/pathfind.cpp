@@ -0,0 +1,84 @@
+#include "check.h"
+#include "maps.h"
+
+using namespace nav;
+
+
+// a mesh from triangles given by hand, portals joined where two triangles share a side
+static Mesh hand_mesh(std::vector<Vector2f> vertices, std::vector<Triangle> triangles) {
+    auto mesh = Mesh();
+    mesh.vertices = std::move(vertices);
+    mesh.triangles = std::move(triangles);
+    mesh.edges.resize(mesh.triangles.size());
+    for (usize i = 0; i < mesh.triangles.size(); i++) {
+        const auto& s = mesh.triangles[i];
+        const usize sides[3][2] = { { s.A, s.B }, { s.B, s.C }, { s.C, s.A } };
+        for (usize j = 0; j < mesh.triangles.size(); j++) {
+            const auto& t = mesh.triangles[j];
+            for (const auto& side : sides) {
+                const auto has = [&](usize v){ return t.A == v || t.B == v || t.C == v; };
+                if (j == i || !has(side[0]) || !has(side[1])) { continue; }
+                const auto a = mesh.vertices[side[0]];
+                const auto b = mesh.vertices[side[1]];
+                mesh.edges[i].push_back(Mesh::Edge{ j, (a + b) * 0.5f, side[0], side[1], (b - a).length() });
+            }
+        }
+    }
+    mesh.bake_clearance();
+    return mesh;
+}
+
+// the goal triangle has a wide portal the agent comes through and a narrow one it never needs
+static void goal_behind_wide_portal() {
+    const auto mesh = hand_mesh(
+        { { 0.f, 0.f }, { 0.4f, 0.f }, { 0.2f, 3.f }, { 3.f, 1.5f }, { 0.2f, -2.f } },
+        { Triangle{ 0, 1, 2 }, Triangle{ 1, 3, 2 }, Triangle{ 0, 4, 1 } });
+    const auto goal = mesh.triangles[0].centroid(mesh.vertices.data());
+    const auto start = mesh.triangles[1].centroid(mesh.vertices.data());
+    const auto dead_end = mesh.triangles[2].centroid(mesh.vertices.data());
+
+    auto& scratch = PathScratch::local();
+    CHECK(mesh.find_corridor(start, goal, scratch, 0.5f));
+    CHECK(scratch.corridor.size() == 2);
+    CHECK(!mesh.pathfind(start, goal, 0.5f).empty());
+    // the way on into the last triangle is the narrow portal, so that one stays out of reach
+    CHECK(!mesh.find_corridor(start, dead_end, scratch, 0.5f));
+    CHECK(mesh.find_corridor(start, dead_end, scratch, 0.1f));
+}
+
+// every goal a wide agent reaches in a generated map is reached without crossing a portal narrower than it
+static void corridors_fit_the_radius() {
+    for (u32 seed = 0; seed < 5; seed++) {
+        const auto mesh = block_mesh(48, seed);
+        auto rng = std::mt19937(seed);
+        auto& scratch = PathScratch::local();
+        usize found = 0;
+        for (usize q = 0; q < 200; q++) {
+            const auto a = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+            const auto b = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+            const auto a_tri = mesh.get_triangle(a);
+            const auto b_tri = mesh.get_triangle(b);
+            if (!mesh.find_corridor(a, b, scratch, 0.4f)) {
+                CHECK(!mesh.find_corridor(*a_tri, *b_tri, a, b, scratch, 0.4f));
+                continue;
+            }
+            found++;
+            // known triangles give the same corridor as looking them up
+            const auto corridor = scratch.corridor;
+            CHECK(mesh.find_corridor(*a_tri, *b_tri, a, b, scratch, 0.4f));
+            CHECK(scratch.corridor.size() == corridor.size());
+            for (usize i = 0; i + 1 < scratch.corridor.size(); i++) {
+                const auto& step = scratch.corridor[i];
+                CHECK(mesh.edges[step.next_index][step.neighbor_index].width >= 0.8f);
+            }
+        }
+        CHECK(found > 0);
+    }
+}
+
+int main() {
+    goal_behind_wide_portal();
+    corridors_fit_the_radius();
+    std::printf("pathfind: %d failed\n", failures());
+    return failures() != 0;
+}
@@ -0,0 +1,105 @@
+#include "check.h"
+#include "maps.h"
+#include <BS_thread_pool.hpp>
+
+using namespace nav;
+
+
+// every corner of a funnel path is a mesh vertex, and the straight line between two consecutive corners
+// is clear by construction
+static void funnel_corners_see_each_other(const Mesh& mesh, std::mt19937& rng) {
+    for (usize q = 0; q < 200; q++) {
+        const auto a = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+        const auto b = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+        const auto path = mesh.pathfind(a, b);
+        for (usize i = 0; i + 1 < path.size(); i++) {
+            CHECK(mesh.raycast(path[i], path[i+1]));
+            CHECK(mesh.raycast(path[i+1], path[i]));
+        }
+    }
+}
+
+// agents track their triangle by tracing from the last one to each new position. walking a path in small steps
+// lands on and leaves from its corners, every step has to be followed without falling back to a lookup
+static void tracking_across_corners(const Mesh& mesh, std::mt19937& rng) {
+    for (usize q = 0; q < 50; q++) {
+        const auto a = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+        const auto b = mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data());
+        const auto path = mesh.pathfind(a, b);
+        auto tri = mesh.get_triangle(a, 0.05f);
+        auto pos = a;
+        for (usize i = 0; tri.has_value() && i + 1 < path.size(); i++) {
+            for (usize k = 1; k <= 4 && tri.has_value(); k++) {
+                const auto next = path[i] + (path[i+1] - path[i]) * ((f32)k / 4.f);
+                tri = mesh.trace(*tri, pos, next);
+                CHECK(tri.has_value());
+                CHECK(!tri.has_value() || mesh.triangles[*tri].contains_with_error(mesh.vertices.data(), next, 1e-4f));
+                pos = next;
+            }
+        }
+    }
+}
+
+// from a vertex towards the centroid of a triangle around it, the segment never leaves that triangle
+static void vertex_to_own_triangle(const Mesh& mesh) {
+    for (usize t = 0; t < mesh.triangles.size(); t++) {
+        const auto& tri = mesh.triangles[t];
+        const auto c = tri.centroid(mesh.vertices.data());
+        for (const auto v : { tri.A, tri.B, tri.C }) {
+            CHECK(mesh.raycast(mesh.vertices[v], c));
+            CHECK(mesh.raycast(c, mesh.vertices[v]));
+        }
+    }
+}
+
+// leaving the floor is always blocked, wherever the ray starts
+static void out_of_bounds_blocked(const Mesh& mesh) {
+    for (usize t = 0; t < mesh.triangles.size(); t++) {
+        const auto& tri = mesh.triangles[t];
+        CHECK(!mesh.raycast(tri.centroid(mesh.vertices.data()), Vector2f{ -5.f, -5.f }));
+        CHECK(!mesh.raycast(mesh.vertices[tri.A], Vector2f{ -5.f, -5.f }));
+    }
+}
+
+// the batch agrees with single queries, with and without start triangles from the caller
+static void batch_matches_single(const Mesh& mesh, std::mt19937& rng) {
+    const auto count = 500;
+    auto begins = std::vector<Vector2f>();
+    auto ends = std::vector<Vector2f>();
+    auto tris = std::vector<usize>();
+    for (usize i = 0; i < count; i++) {
+        const auto t = rng() % mesh.triangles.size();
+        const auto& tri = mesh.triangles[t];
+        begins.push_back(i % 2 ? mesh.vertices[tri.A] : tri.centroid(mesh.vertices.data()));
+        ends.push_back(mesh.triangles[rng() % mesh.triangles.size()].centroid(mesh.vertices.data()));
+        tris.push_back(t);
+    }
+    auto looked_up = std::vector<u8>(count);
+    auto given = std::vector<u8>(count);
+    auto pooled = std::vector<u8>(count);
+    auto pool = ThreadPool(3);
+    mesh.raycast_batch(begins.data(), ends.data(), count, looked_up.data());
+    mesh.raycast_batch(tris.data(), begins.data(), ends.data(), count, given.data());
+    mesh.raycast_batch(tris.data(), begins.data(), ends.data(), count, pooled.data(), pool);
+    for (usize i = 0; i < count; i++) {
+        const auto single = mesh.raycast(tris[i], begins[i], ends[i]);
+        CHECK(looked_up[i] == single);
+        CHECK(given[i] == single);
+        CHECK(pooled[i] == single);
+    }
+}
+
+
+int main() {
+    auto rng = std::mt19937(1);
+    for (u32 seed = 0; seed < 10; seed++) {
+        const auto mesh = block_mesh(48, seed);
+        funnel_corners_see_each_other(mesh, rng);
+        tracking_across_corners(mesh, rng);
+        vertex_to_own_triangle(mesh);
+        out_of_bounds_blocked(mesh);
+        batch_matches_single(mesh, rng);
+    }
+    std::printf("raycast: %d failed\n", failures());
+    return failures() != 0;
+}
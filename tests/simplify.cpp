@@ -0,0 +1,101 @@
+#include "check.h"
+#include "maps.h"
+#include "../src/simplify.h"
+
+using namespace nav;
+
+
+static std::vector<Polygon> outlines(usize size, u32 seed, Method method) {
+    const auto grid = block_grid(size, seed);
+    const auto mask = build_mask(grid.data(), size, size, 1, [](const u8* cell) { return *cell != 0; }, nullptr);
+    return method == Method::MARCHING_SQUARES ? marching_squares(mask, nullptr) : floodfill(mask, nullptr);
+}
+
+// loops may repeat their first point at the end, it is only counted once
+static usize open_size(const Polygon& loop) {
+    return loop.size() > 1 && loop.front() == loop.back() ? loop.size() - 1 : loop.size();
+}
+
+static usize point_count(const std::vector<Polygon>& loops) {
+    usize count = 0;
+    for (const auto& loop : loops) { count += open_size(loop); }
+    return count;
+}
+
+static i64 turn(Vector2i a, Vector2i b, Vector2i c) {
+    return ((i64)b.x - a.x) * ((i64)c.y - a.y) - ((i64)c.x - a.x) * ((i64)b.y - a.y);
+}
+
+static bool on_segment(Vector2i a, Vector2i b, Vector2i p) {
+    return std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) && std::min(a.y, b.y) <= p.y && p.y <= std::max(a.y, b.y);
+}
+
+// whether segments ab and cd touch at all, ends included
+static bool touch(Vector2i a, Vector2i b, Vector2i c, Vector2i d) {
+    const auto d1 = turn(c, d, a);
+    const auto d2 = turn(c, d, b);
+    const auto d3 = turn(a, b, c);
+    const auto d4 = turn(a, b, d);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) { return true; }
+    return (d1 == 0 && on_segment(c, d, a)) || (d2 == 0 && on_segment(c, d, b))
+        || (d3 == 0 && on_segment(a, b, c)) || (d4 == 0 && on_segment(a, b, d));
+}
+
+// no side of any loop touches another side, of the same loop or another one, other than its neighbours at the
+// points they share
+static usize crossings(const std::vector<Polygon>& loops) {
+    struct Side { usize loop, i, n; Vector2i a, b; };
+    auto sides = std::vector<Side>();
+    for (usize l = 0; l < loops.size(); l++) {
+        const auto n = open_size(loops[l]);
+        for (usize i = 0; i < n; i++) { sides.push_back({ l, i, n, loops[l][i], loops[l][(i + 1) % n] }); }
+    }
+    usize count = 0;
+    for (usize s = 0; s < sides.size(); s++) {
+        for (usize t = s + 1; t < sides.size(); t++) {
+            const auto& x = sides[s];
+            const auto& y = sides[t];
+            if (x.loop == y.loop && (y.i == (x.i + 1) % x.n || x.i == (y.i + 1) % y.n)) {
+                // neighbours share one point and must not fold back over each other
+                const auto shared = y.i == (x.i + 1) % x.n ? x.b : x.a;
+                const auto far_x = shared == x.b ? x.a : x.b;
+                const auto far_y = shared == y.a ? y.b : y.a;
+                count += x.n > 3 && turn(shared, far_x, far_y) == 0 && on_segment(shared, far_x, far_y);
+                continue;
+            }
+            count += touch(x.a, x.b, y.a, y.b);
+        }
+    }
+    return count;
+}
+
+// a budget the outlines can be thinned to is met to the point, and no outline is cut below a triangle.
+// halfway down to three points a loop leaves room for the points that would make outlines cross
+static void meets_the_budget(const std::vector<Polygon>& loops) {
+    const auto budget = (point_count(loops) + 3 * loops.size()) / 2;
+    const auto thinned = visvalingam_whyatt(loops, 0.f, budget);
+    CHECK(thinned.size() == loops.size());
+    CHECK(point_count(thinned) == budget);
+    CHECK(crossings(thinned) == 0);
+    for (const auto& loop : thinned) { CHECK(open_size(loop) >= 3); }
+}
+
+// a budget far below what the map allows stops where the next point would make outlines cross
+static void never_crosses(const std::vector<Polygon>& loops) {
+    const auto thinned = visvalingam_whyatt(loops, 0.f, 1);
+    CHECK(point_count(thinned) >= 3 * loops.size());
+    CHECK(crossings(thinned) == 0);
+}
+
+int main() {
+    for (u32 seed = 1; seed <= 5; seed++) {
+        for (const auto method : { Method::MARCHING_SQUARES, Method::FLOODFILL }) {
+            const auto loops = outlines(48, seed, method);
+            CHECK(crossings(loops) == 0);
+            meets_the_budget(loops);
+            never_crosses(loops);
+        }
+    }
+    std::printf("simplify: %d failed\n", failures());
+    return failures() != 0;
+}